@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 #include <iostream>
 #include <chrono>
@@ -37,6 +38,7 @@
 #include <ctime>
 #include <cstring>
 
+#include <vector>
 
 
 auto start_time = std::chrono::high_resolution_clock::now();
@@ -203,22 +205,92 @@ void MsSerial(int *array, int *tmp, const size_t size) {
 }
 
 
+/**
+  * (re-)initialize the input array, deterministic for a given size
+  */
+void initData(int *data, const size_t size) {
+	#pragma omp parallel for
+	for (size_t idx = 0; idx < size; ++idx){
+		unsigned int seed = 95 + idx;
+		data[idx] = (int) (size * (double(rand_r(&seed)) / RAND_MAX));
+	}
+}
+
+/**
+  * helper routine: print min/median/mean/stddev over all measured repetitions,
+  * returns the median
+  */
+double printStatistics(std::vector<double> timings) {
+	const size_t reps = timings.size();
+	std::sort(timings.begin(), timings.end());
+
+	double mean = 0.0;
+	for (double t : timings) {
+		mean += t;
+	}
+	mean /= reps;
+
+	double var = 0.0;
+	for (double t : timings) {
+		var += (t - mean) * (t - mean);
+	}
+	double stddev = (reps > 1) ? std::sqrt(var / (reps - 1)) : 0.0;
+
+	double median = (reps % 2) ? timings[reps / 2]
+	                           : 0.5 * (timings[reps / 2 - 1] + timings[reps / 2]);
+
+	printf("\n");
+	printf("Time measurements\n");
+	printf("Number of Repetitions:     %zu\n", reps);
+	printf("Minimum sort time:         %f\n", timings.front());
+	printf("Maximum sort time:         %f\n", timings.back());
+	printf("Median sort time:          %f\n", median);
+	printf("Arithm. Mean sort time:    %f\n", mean);
+	printf("Std. deviation:            %f\n", stddev);
+	printf("\n");
+
+	return median;
+}
+
+void printUsage() {
+	printf("Usage: MergeSort.exe [-r <repetitions>] [-w <warmups>] <array size> \n");
+	printf("\n");
+}
+
 /** 
   * @brief program entry point
   */
 int main(int argc, char* argv[]) {
-	// variables to measure the elapsed time
-	struct timeval t1, t2;
-	double etime;
+	// number of measured and unmeasured sort runs within this process
+	long numReps = 1;
+	long numWarmups = -1;
 
 	// expect one command line arguments: array size
     print_timestamp("Start of main");
-	if (argc != 2) {
-		printf("Usage: MergeSort.exe <array size> \n");
-		printf("\n");
+	int c;
+	while ((c = getopt(argc, argv, "r:w:")) != -1) {
+		switch (c) {
+		case 'r':
+			numReps = strtol(optarg, NULL, 10);
+			break;
+		case 'w':
+			numWarmups = strtol(optarg, NULL, 10);
+			break;
+		default:
+			printUsage();
+			return EXIT_FAILURE;
+		}
+	}
+	// warm up once by default, but only when repeating anyway
+	if (numWarmups < 0) {
+		numWarmups = (numReps > 1) ? 1 : 0;
+	}
+
+	if (argc - optind != 1 || numReps < 1) {
+		printUsage();
 		return EXIT_FAILURE;
 	} else {
-		const size_t stSize = strtol(argv[1], NULL, 10);
+		const size_t stSize = strtol(argv[optind], NULL, 10);
 		int *data = (int*) malloc(stSize * sizeof(int));
 		int *tmp = (int*) malloc(stSize * sizeof(int));
 		int *ref = (int*) malloc(stSize * sizeof(int));
@@ -226,11 +298,7 @@ int main(int argc, char* argv[]) {
 
 		printf("Initialization...\n");
 
-		#pragma omp parallel for
-		for (size_t idx = 0; idx < stSize; ++idx){
-			unsigned int seed = 95 + idx;
-			data[idx] = (int) (stSize * (double(rand_r(&seed)) / RAND_MAX));
-		}
+		initData(data, stSize);
         print_timestamp("Data initialized");
 		std::copy(data, data + stSize, ref);
         print_timestamp("Reference copy created");
@@ -238,13 +306,26 @@ int main(int argc, char* argv[]) {
 		double dSize = (stSize * sizeof(int)) / 1024 / 1024;
 		printf("Sorting %zu elements of type int (%f MiB)...\n", stSize, dSize);
 
-        print_timestamp("Before MsSerial");
-		gettimeofday(&t1, NULL);
-		MsSerial(data, tmp, stSize);
-		gettimeofday(&t2, NULL);
+		std::vector<double> timings;
+		timings.reserve(numReps);
+		for (long rep = 0; rep < numWarmups + numReps; ++rep) {
+			// restore the unsorted input, first run uses the initial data
+			if (rep > 0) {
+				initData(data, stSize);
+			}
+
+			auto begin = std::chrono::steady_clock::now();
+			MsSerial(data, tmp, stSize);
+			auto end = std::chrono::steady_clock::now();
+
+			if (rep >= numWarmups) {
+				timings.push_back(std::chrono::duration<double>(end - begin).count());
+			}
+		}
         print_timestamp("After MsSerial");
-		etime = (t2.tv_sec - t1.tv_sec) * 1000 + (t2.tv_usec - t1.tv_usec) / 1000;
-		etime = etime / 1000;
+
+		// report the median so that single and repeated runs parse the same way
+		double etime = (numReps > 1) ? printStatistics(timings) : timings[0];
 
 		printf("done, took %f sec. Verification...", etime);
 		if (isSorted(ref, data, stSize)) {
@@ -0,0 +1,230 @@
+#include "bcsr.h"
+
+#include <omp.h>
+#include <numa.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// first column of the block holding column c
+static inline int blockStart(int c, int C, int n)
+{
+	int s = c / C * C;
+	return (s + C > n) ? std::max(n - C, 0) : s;
+}
+
+/**
+ * Distinct (block row, block start) pairs of rows rowBeg .. rowEnd-1,
+ * rowBeg being a multiple of R.
+ */
+static long countBlocks(ooo_input *tInput, int rowBeg, int rowEnd, int R, int C, std::vector<int64_t> &keys)
+{
+	keys.clear();
+	for (int i = rowBeg; i < rowEnd; i++)
+	{
+		for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1]; nz++)
+		{
+			keys.push_back(((int64_t) (i / R) << 32) | (uint32_t) blockStart(tInput->col[nz], C, tInput->stNumRows));
+		}
+	}
+	std::sort(keys.begin(), keys.end());
+	return std::unique(keys.begin(), keys.end()) - keys.begin();
+}
+
+void detectBlockSize(ooo_input *tInput, int *iBlockRows, int *iBlockCols)
+{
+	int n = tInput->stNumRows;
+	int windows = (n + BCSR_WINDOW_ROWS - 1) / BCSR_WINDOW_ROWS;
+	int stride = std::max(windows / BCSR_SAMPLE_WINDOWS, 1);
+	const int B = BCSR_MAX_BLOCK;
+	long blocks[B * B] = {};
+	long nnz = 0;
+
+	#pragma omp parallel for schedule(dynamic, 16) reduction(+:nnz, blocks[:B * B])
+	for (int w = 0; w < windows; w += stride)
+	{
+		std::vector<int64_t> keys;
+		int rowBeg = w * BCSR_WINDOW_ROWS;
+		int rowEnd = std::min(rowBeg + BCSR_WINDOW_ROWS, n);
+		nnz += tInput->row[rowEnd] - tInput->row[rowBeg];
+		for (int R = 1; R <= std::min(B, n); R++)
+		{
+			for (int C = 1; C <= std::min(B, n); C++)
+			{
+				blocks[(R - 1) * B + C - 1] += countBlocks(tInput, rowBeg, rowEnd, R, C, keys);
+			}
+		}
+	}
+
+	// plain CSR unless blocking saves traffic
+	*iBlockRows = 1;
+	*iBlockCols = 1;
+	double dBest = 8.0 + 4.0;
+	for (int R = 1; R <= std::min(B, n); R++)
+	{
+		for (int C = 1; C <= std::min(B, n); C++)
+		{
+			double fill = (double) blocks[(R - 1) * B + C - 1] * R * C / std::max(nnz, 1L);
+			double bytes = fill * (8.0 + 4.0 / (R * C));
+			if (bytes < dBest - 1e-9)
+			{
+				dBest = bytes;
+				*iBlockRows = R;
+				*iBlockCols = C;
+			}
+		}
+	}
+}
+
+void convertToBcsr(ooo_input *tInput, int iBlockRows, int iBlockCols, int iNumParts, ooo_bcsr *tBcsr)
+{
+	int n = tInput->stNumRows;
+	if (iBlockRows <= 0 || iBlockCols <= 0)
+	{
+		detectBlockSize(tInput, &iBlockRows, &iBlockCols);
+	}
+	const int R = std::min(iBlockRows, std::max(n, 1));
+	const int C = std::min(iBlockCols, std::max(n, 1));
+	const int nbr = (n + R - 1) / R;
+	tBcsr->iNumRows = n;
+	tBcsr->iBlockRows = R;
+	tBcsr->iBlockCols = C;
+	tBcsr->iNumBlockRows = nbr;
+
+	// blocks per block row
+	tBcsr->browPtr = (int64_t*) numa_alloc(sizeof(int64_t) * (nbr + 1));
+	tBcsr->browPtr[0] = 0;
+	#pragma omp parallel
+	{
+		std::vector<int64_t> keys;
+		#pragma omp for schedule(dynamic, 256)
+		for (int ib = 0; ib < nbr; ib++)
+		{
+			tBcsr->browPtr[ib + 1] = countBlocks(tInput, ib * R, std::min(ib * R + R, n), R, C, keys);
+		}
+	}
+	for (int ib = 0; ib < nbr; ib++)
+	{
+		tBcsr->browPtr[ib + 1] += tBcsr->browPtr[ib];
+	}
+	int64_t numBlocks = tBcsr->browPtr[nbr];
+	tBcsr->stNumBlocks = numBlocks;
+	tBcsr->dFill = (double) numBlocks * R * C / std::max<int64_t>(tInput->stNumNonzeros, 1);
+
+	partitionRows(tBcsr->browPtr, nbr, iNumParts, &tBcsr->tPart);
+	tBcsr->bcol = (int*) numa_alloc(sizeof(int) * std::max<int64_t>(numBlocks, 1));
+	tBcsr->val = (double*) numa_alloc(sizeof(double) * R * C * std::max<int64_t>(numBlocks, 1));
+
+	// fill with the kernel's thread placement (first touch)
+	#pragma omp parallel num_threads(iNumParts) proc_bind(spread)
+	{
+		std::vector<int64_t> keys;
+		for (int t = omp_get_thread_num(); t < iNumParts; t += omp_get_num_threads())
+		{
+			for (int ib = tBcsr->tPart.rowPtr[t]; ib < tBcsr->tPart.rowPtr[t+1]; ib++)
+			{
+				int rowBeg = ib * R;
+				int rowEnd = std::min(rowBeg + R, n);
+				int64_t first = tBcsr->browPtr[ib];
+				int count = (int) countBlocks(tInput, rowBeg, rowEnd, R, C, keys);
+				for (int k = 0; k < count; k++)
+				{
+					tBcsr->bcol[first + k] = (int) (uint32_t) keys[k];
+				}
+				std::fill(tBcsr->val + (size_t) first * R * C, tBcsr->val + (size_t) (first + count) * R * C, 0.0);
+				for (int i = rowBeg; i < rowEnd; i++)
+				{
+					for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1]; nz++)
+					{
+						int c = tInput->col[nz];
+						int s = blockStart(c, C, n);
+						int64_t k = std::lower_bound(tBcsr->bcol + first, tBcsr->bcol + first + count, s) - tBcsr->bcol;
+						tBcsr->val[(size_t) k * R * C + (i - rowBeg) * C + (c - s)] += tInput->val[nz];
+					}
+				}
+			}
+		}
+	}
+
+	std::cout << "BCSR: " << R << "x" << C << " blocks, " << numBlocks << " blocks, fill ratio " << tBcsr->dFill << std::endl;
+}
+
+/**
+ * Block rows of thread t, R x C fixed at compile time so the block loops
+ * unroll and the R sums stay in registers.
+ */
+template<int R, int C>
+static void spmxvBcsrBlock(const ooo_bcsr *tBcsr, int t, const double * __restrict__ x, double * __restrict__ y)
+{
+	const int64_t * __restrict__ browPtr = tBcsr->browPtr;
+	const int    * __restrict__ bcol = tBcsr->bcol;
+	const double * __restrict__ val = tBcsr->val;
+	const int n = tBcsr->iNumRows;
+
+	for (int ib = tBcsr->tPart.rowPtr[t]; ib < tBcsr->tPart.rowPtr[t+1]; ib++)
+	{
+		double sum[R] = {};
+		for (int64_t k = browPtr[ib]; k < browPtr[ib+1]; k++)
+		{
+			const double *b = val + (size_t) k * R * C;
+			const double *xb = x + bcol[k];
+			for (int r = 0; r < R; r++)
+			{
+				for (int c = 0; c < C; c++)
+				{
+					sum[r] += b[r * C + c] * xb[c];
+				}
+			}
+		}
+
+		// only the last block row can be partial
+		if (ib * R + R <= n)
+		{
+			for (int r = 0; r < R; r++)
+			{
+				y[ib * R + r] = sum[r];
+			}
+		}
+		else
+		{
+			for (int r = 0; r < n - ib * R; r++)
+			{
+				y[ib * R + r] = sum[r];
+			}
+		}
+	}
+}
+
+typedef void (*bcsr_kernel)(const ooo_bcsr*, int, const double*, double*);
+
+static const bcsr_kernel bcsrKernels[BCSR_MAX_BLOCK][BCSR_MAX_BLOCK] =
+{
+	{ spmxvBcsrBlock<1, 1>, spmxvBcsrBlock<1, 2>, spmxvBcsrBlock<1, 3>, spmxvBcsrBlock<1, 4> },
+	{ spmxvBcsrBlock<2, 1>, spmxvBcsrBlock<2, 2>, spmxvBcsrBlock<2, 3>, spmxvBcsrBlock<2, 4> },
+	{ spmxvBcsrBlock<3, 1>, spmxvBcsrBlock<3, 2>, spmxvBcsrBlock<3, 3>, spmxvBcsrBlock<3, 4> },
+	{ spmxvBcsrBlock<4, 1>, spmxvBcsrBlock<4, 2>, spmxvBcsrBlock<4, 3>, spmxvBcsrBlock<4, 4> },
+};
+
+void spmxvBcsr(ooo_bcsr *tBcsr, const double *x, double *y)
+{
+	bcsr_kernel kernel = bcsrKernels[tBcsr->iBlockRows - 1][tBcsr->iBlockCols - 1];
+
+	#pragma omp parallel num_threads(tBcsr->tPart.iNumParts) proc_bind(spread)
+	{
+		for (int t = omp_get_thread_num(); t < tBcsr->tPart.iNumParts; t += omp_get_num_threads())
+		{
+			kernel(tBcsr, t, x, y);
+		}
+	}
+}
+
+void freeBcsr(ooo_bcsr *tBcsr)
+{
+	int RC = tBcsr->iBlockRows * tBcsr->iBlockCols;
+	numa_free(tBcsr->browPtr, sizeof(int64_t) * (tBcsr->iNumBlockRows + 1));
+	numa_free(tBcsr->bcol, sizeof(int) * std::max<int64_t>(tBcsr->stNumBlocks, 1));
+	numa_free(tBcsr->val, sizeof(double) * RC * std::max<int64_t>(tBcsr->stNumBlocks, 1));
+	freePartition(&tBcsr->tPart);
+}
@@ -0,0 +1,49 @@
+#ifndef INC_BCSR_H
+#define INC_BCSR_H
+
+#include "ooo_cmdline.h"
+#include "csr.h"
+
+// largest block dimension
+#define BCSR_MAX_BLOCK 4
+// rows of a detection window, a multiple of every block height
+#define BCSR_WINDOW_ROWS 12
+// detection windows sampled at most
+#define BCSR_SAMPLE_WINDOWS 2048
+
+/**
+ * Register-blocked CSR with dense iBlockRows x iBlockCols blocks, stored
+ * row-major and zero-filled. Block row ib covers rows ib * R .. ib * R + R - 1
+ * (the last one may be partial) and has blocks browPtr[ib] .. browPtr[ib+1]-1.
+ * bcol holds the first column of a block. Blocks start at multiples of C,
+ * except that the last block column is moved left to end at column n - 1,
+ * so the kernels never read x beyond n.
+ */
+struct ooo_bcsr
+{
+	int				iNumRows;
+	int				iBlockRows;		// R
+	int				iBlockCols;		// C
+	int				iNumBlockRows;
+	int64_t			stNumBlocks;
+	ooo_partition	tPart;			// block rows per thread
+	int64_t			*browPtr;
+	int				*bcol;
+	double			*val;
+	double			dFill;			// stored entries / nonzeros
+};
+
+/**
+ * Estimates the fill ratio (stored entries / nonzeros) of every block size
+ * from 1x1 to 4x4 on up to BCSR_SAMPLE_WINDOWS evenly spaced windows of
+ * BCSR_WINDOW_ROWS rows, and returns the size with the least modelled
+ * matrix traffic per nonzero, fill * (8 + 4 / (R * C)) bytes.
+ */
+void detectBlockSize(ooo_input *tInput, int *iBlockRows, int *iBlockCols);
+
+// iBlockRows / iBlockCols 0 detect the block size
+void convertToBcsr(ooo_input *tInput, int iBlockRows, int iBlockCols, int iNumParts, ooo_bcsr *tBcsr);
+void spmxvBcsr(ooo_bcsr *tBcsr, const double *x, double *y);
+void freeBcsr(ooo_bcsr *tBcsr);
+
+#endif
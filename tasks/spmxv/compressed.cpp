@@ -0,0 +1,182 @@
+#include "compressed.h"
+
+#include <omp.h>
+#include <numa.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+template<typename ValT, typename IdxT>
+static void cmpBlock(const ooo_cmp_block &b, const int64_t *Arow, const ValT * __restrict__ val, const IdxT * __restrict__ col, const double *x, double *y)
+{
+	// 16 bit offsets are relative to the block's first column
+	const double * __restrict__ xb = x + b.iColBase;
+	const int64_t nz0 = Arow[b.iRowBegin];
+
+	for (int i = b.iRowBegin; i < b.iRowEnd; i++)
+	{
+		// no forced simd: for short rows the scalar loop beats masked gathers
+		double sum = 0.0;
+		for (int64_t j = Arow[i] - nz0; j < Arow[i+1] - nz0; j++)
+		{
+			sum += (double) val[j] * xb[col[j]];
+		}
+
+		y[i] = sum;
+	}
+}
+
+void convertToCompressed(ooo_input *tInput, ooo_partition *tPart, int iValuePrecision, ooo_cmp_csr *tCmp)
+{
+	int64_t *row = tInput->row;
+	std::vector<ooo_cmp_block> blocks;
+
+	// fixed-size row blocks, never crossing partition blocks
+	tCmp->partBlockPtr = new int[tPart->iNumParts + 1];
+	for (int t = 0; t < tPart->iNumParts; t++)
+	{
+		tCmp->partBlockPtr[t] = blocks.size();
+		for (int i = tPart->rowPtr[t]; i < tPart->rowPtr[t+1]; i += CMP_BLOCK_ROWS)
+		{
+			ooo_cmp_block b;
+			b.iRowBegin = i;
+			b.iRowEnd = std::min(i + CMP_BLOCK_ROWS, tPart->rowPtr[t+1]);
+			blocks.push_back(b);
+		}
+	}
+	tCmp->partBlockPtr[tPart->iNumParts] = blocks.size();
+	int numBlocks = blocks.size();
+
+	// choose the storage type of every block
+	#pragma omp parallel for schedule(dynamic, 64)
+	for (int k = 0; k < numBlocks; k++)
+	{
+		ooo_cmp_block &b = blocks[k];
+		int minCol = std::numeric_limits<int>::max();
+		int maxCol = 0;
+		bool bExactFloat = true;
+		for (int64_t nz = row[b.iRowBegin]; nz < row[b.iRowEnd]; nz++)
+		{
+			minCol = std::min(minCol, tInput->col[nz]);
+			maxCol = std::max(maxCol, tInput->col[nz]);
+			bExactFloat = bExactFloat && (double) (float) tInput->val[nz] == tInput->val[nz];
+		}
+		b.bShortIdx = (row[b.iRowEnd] == row[b.iRowBegin]) || (maxCol - minCol <= 0xFFFF);
+		b.iColBase = (b.bShortIdx && row[b.iRowEnd] > row[b.iRowBegin]) ? minCol : 0;
+		b.bFloatVal = (iValuePrecision == VALUE_FLOAT) || (iValuePrecision == VALUE_AUTO && bExactFloat);
+	}
+
+	// offsets into the typed arrays
+	size_t num16 = 0, num32 = 0, numF = 0, numD = 0;
+	for (int k = 0; k < numBlocks; k++)
+	{
+		ooo_cmp_block &b = blocks[k];
+		size_t nnz = row[b.iRowEnd] - row[b.iRowBegin];
+		size_t &idx = b.bShortIdx ? num16 : num32;
+		size_t &val = b.bFloatVal ? numF : numD;
+		b.stIdxOffset = idx;
+		b.stValOffset = val;
+		idx += nnz;
+		val += nnz;
+	}
+
+	tCmp->iNumBlocks = numBlocks;
+	tCmp->blocks = new ooo_cmp_block[numBlocks];
+	std::copy(blocks.begin(), blocks.end(), tCmp->blocks);
+	tCmp->stNum16 = num16;
+	tCmp->stNum32 = num32;
+	tCmp->stNumF = numF;
+	tCmp->stNumD = numD;
+	tCmp->col16 = (uint16_t*) numa_alloc(sizeof(uint16_t) * std::max<size_t>(num16, 1));
+	tCmp->col32 = (int*) numa_alloc(sizeof(int) * std::max<size_t>(num32, 1));
+	tCmp->val32 = (float*) numa_alloc(sizeof(float) * std::max<size_t>(numF, 1));
+	tCmp->val64 = (double*) numa_alloc(sizeof(double) * std::max<size_t>(numD, 1));
+
+	// fill with the kernel's thread placement (first touch)
+	double maxRelError = 0.0;
+	#pragma omp parallel num_threads(tPart->iNumParts) proc_bind(spread) reduction(max:maxRelError)
+	{
+		for (int t = omp_get_thread_num(); t < tPart->iNumParts; t += omp_get_num_threads())
+		{
+			for (int k = tCmp->partBlockPtr[t]; k < tCmp->partBlockPtr[t+1]; k++)
+			{
+				const ooo_cmp_block &b = tCmp->blocks[k];
+				int64_t nz0 = row[b.iRowBegin];
+				for (int64_t nz = nz0; nz < row[b.iRowEnd]; nz++)
+				{
+					size_t j = nz - nz0;
+					double v = tInput->val[nz];
+					if (b.bShortIdx)
+					{
+						tCmp->col16[b.stIdxOffset + j] = tInput->col[nz] - b.iColBase;
+					}
+					else
+					{
+						tCmp->col32[b.stIdxOffset + j] = tInput->col[nz];
+					}
+					if (b.bFloatVal)
+					{
+						tCmp->val32[b.stValOffset + j] = (float) v;
+						if (v != 0.0)
+						{
+							maxRelError = std::max(maxRelError, std::fabs(((double) (float) v - v) / v));
+						}
+					}
+					else
+					{
+						tCmp->val64[b.stValOffset + j] = v;
+					}
+				}
+			}
+		}
+	}
+
+	size_t nnz = tInput->stNumNonzeros;
+	double bytes = 2.0 * num16 + 4.0 * num32 + 4.0 * numF + 8.0 * numD;
+	std::cout << "Compressed CSR: " << 100.0 * num16 / std::max<size_t>(nnz, 1) << "% 16 bit column offsets, "
+		<< 100.0 * numF / std::max<size_t>(nnz, 1) << "% float values, "
+		<< bytes / std::max<size_t>(nnz, 1) << " bytes per nonzero (CSR: 12), "
+		<< "max. relative value rounding " << maxRelError << std::endl;
+}
+
+void spmxvCompressed(ooo_cmp_csr *tCmp, ooo_partition *tPart, const int64_t *Arow, const double *x, double *y)
+{
+	#pragma omp parallel num_threads(tPart->iNumParts) proc_bind(spread)
+	{
+		for (int t = omp_get_thread_num(); t < tPart->iNumParts; t += omp_get_num_threads())
+		{
+			for (int k = tCmp->partBlockPtr[t]; k < tCmp->partBlockPtr[t+1]; k++)
+			{
+				const ooo_cmp_block &b = tCmp->blocks[k];
+				if (b.bShortIdx && b.bFloatVal)
+				{
+					cmpBlock(b, Arow, tCmp->val32 + b.stValOffset, tCmp->col16 + b.stIdxOffset, x, y);
+				}
+				else if (b.bShortIdx)
+				{
+					cmpBlock(b, Arow, tCmp->val64 + b.stValOffset, tCmp->col16 + b.stIdxOffset, x, y);
+				}
+				else if (b.bFloatVal)
+				{
+					cmpBlock(b, Arow, tCmp->val32 + b.stValOffset, tCmp->col32 + b.stIdxOffset, x, y);
+				}
+				else
+				{
+					cmpBlock(b, Arow, tCmp->val64 + b.stValOffset, tCmp->col32 + b.stIdxOffset, x, y);
+				}
+			}
+		}
+	}
+}
+
+void freeCompressed(ooo_cmp_csr *tCmp)
+{
+	numa_free(tCmp->col16, sizeof(uint16_t) * std::max<size_t>(tCmp->stNum16, 1));
+	numa_free(tCmp->col32, sizeof(int) * std::max<size_t>(tCmp->stNum32, 1));
+	numa_free(tCmp->val32, sizeof(float) * std::max<size_t>(tCmp->stNumF, 1));
+	numa_free(tCmp->val64, sizeof(double) * std::max<size_t>(tCmp->stNumD, 1));
+	delete[] tCmp->blocks;
+	delete[] tCmp->partBlockPtr;
+}
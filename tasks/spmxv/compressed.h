@@ -0,0 +1,52 @@
+#ifndef INC_COMPRESSED_H
+#define INC_COMPRESSED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ooo_cmdline.h"
+#include "csr.h"
+
+// rows per compression block
+#define CMP_BLOCK_ROWS 128
+
+/**
+ * Block of rows sharing one storage type. Column indices are stored as
+ * 16 bit offsets from iColBase, the smallest column of the block, if the
+ * block's column span allows it, values as float if requested (or, in auto
+ * mode, if all of them are exact floats).
+ */
+struct ooo_cmp_block
+{
+	int				iRowBegin;
+	int				iRowEnd;
+	int				iColBase;
+	bool			bShortIdx;
+	bool			bFloatVal;
+	size_t			stIdxOffset;	// into col16 or col32
+	size_t			stValOffset;	// into val32 or val64
+};
+
+/**
+ * Compressed CSR, row pointers are shared with the plain CSR arrays.
+ */
+struct ooo_cmp_csr
+{
+	int				iNumBlocks;
+	ooo_cmp_block	*blocks;
+	int				*partBlockPtr;	// blocks of partition block t start at partBlockPtr[t]
+	uint16_t		*col16;
+	int				*col32;
+	float			*val32;
+	double			*val64;
+	size_t			stNum16;
+	size_t			stNum32;
+	size_t			stNumF;
+	size_t			stNumD;
+};
+
+void convertToCompressed(ooo_input *tInput, ooo_partition *tPart, int iValuePrecision, ooo_cmp_csr *tCmp);
+void spmxvCompressed(ooo_cmp_csr *tCmp, ooo_partition *tPart, const int64_t *Arow, const double *x, double *y);
+void freeCompressed(ooo_cmp_csr *tCmp);
+
+#endif
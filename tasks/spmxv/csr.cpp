@@ -0,0 +1,438 @@
+#include "csr.h"
+
+#include <omp.h>
+#include <immintrin.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+/**
+ * Dot product of a long row with x using hardware gathers where available.
+ */
+static inline double rowLong(const double * __restrict__ val, const int * __restrict__ col, int len, const double * __restrict__ x)
+{
+	int k = 0;
+	double sum = 0.0;
+#if defined(__AVX512F__)
+	__m512d acc = _mm512_setzero_pd();
+	for (; k + 8 <= len; k += 8)
+	{
+		__m256i idx = _mm256_loadu_si256((const __m256i*) (col + k));
+		__m512d xv = _mm512_i32gather_pd(idx, x, 8);
+		acc = _mm512_fmadd_pd(_mm512_loadu_pd(val + k), xv, acc);
+	}
+	sum = _mm512_reduce_add_pd(acc);
+#elif defined(__AVX2__) && defined(__FMA__)
+	__m256d acc = _mm256_setzero_pd();
+	for (; k + 4 <= len; k += 4)
+	{
+		__m128i idx = _mm_loadu_si128((const __m128i*) (col + k));
+		__m256d xv = _mm256_i32gather_pd(x, idx, 8);
+		acc = _mm256_fmadd_pd(_mm256_loadu_pd(val + k), xv, acc);
+	}
+	__m128d lo = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+	sum = _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+#endif
+	for (; k < len; k++)
+	{
+		sum += val[k] * x[col[k]];
+	}
+	return sum;
+}
+
+typedef void (*segment_kernel)(const ooo_csr_segment &seg, const int64_t *Arow, const int *Acol, const double *Aval, const double *x, double *y);
+
+/**
+ * Rows of varying length, dispatched per row.
+ */
+static void csrMixedSegment(const ooo_csr_segment &seg, const int64_t *Arow, const int *Acol, const double *Aval, const double *x, double *y)
+{
+	for (int i = seg.iRowBegin; i < seg.iRowEnd; i++)
+	{
+		int64_t rowbeg = Arow[i];
+		int len = (int) (Arow[i+1] - rowbeg);
+		if (len >= CSR_LONG_ROW_LEN)
+		{
+			y[i] = rowLong(Aval + rowbeg, Acol + rowbeg, len, x);
+			continue;
+		}
+
+		double sum = 0.0;
+		#pragma omp simd reduction(+:sum)
+		for (int64_t j = rowbeg; j < rowbeg + len; j++)
+		{
+			sum += Aval[j] * x[Acol[j]];
+		}
+		y[i] = sum;
+	}
+}
+
+/**
+ * Rows of compile-time length L, the inner loop is fully unrolled.
+ */
+template<int L>
+static void csrFixedSegment(const ooo_csr_segment &seg, const int64_t *Arow, const int *Acol, const double *Aval, const double *x, double *y)
+{
+	const double * __restrict__ val = Aval + Arow[seg.iRowBegin];
+	const int    * __restrict__ col = Acol + Arow[seg.iRowBegin];
+
+	for (int i = seg.iRowBegin; i < seg.iRowEnd; i++)
+	{
+		double sum = 0.0;
+		for (int k = 0; k < L; k++)
+		{
+			sum += val[k] * x[col[k]];
+		}
+		y[i] = sum;
+		val += L;
+		col += L;
+	}
+}
+
+// indexed by segment row length, 0 selects the mixed kernel
+static const segment_kernel segmentKernels[CSR_MAX_FIXED_LEN + 1] = {
+	csrMixedSegment,
+	csrFixedSegment<1>,  csrFixedSegment<2>,  csrFixedSegment<3>,  csrFixedSegment<4>,
+	csrFixedSegment<5>,  csrFixedSegment<6>,  csrFixedSegment<7>,  csrFixedSegment<8>,
+	csrFixedSegment<9>,  csrFixedSegment<10>, csrFixedSegment<11>, csrFixedSegment<12>,
+	csrFixedSegment<13>, csrFixedSegment<14>, csrFixedSegment<15>, csrFixedSegment<16>
+};
+
+void partitionRows(const int64_t *Arow, int iNumRows, int iNumParts, ooo_partition *tPart)
+{
+	tPart->iNumParts = iNumParts;
+	tPart->rowPtr = new int[iNumParts + 1];
+
+	// split the merge path of (rows + nonzeros) evenly, but only at row boundaries:
+	// block t starts at the first row r with r + Arow[r] >= t * total / parts
+	long total = (long) iNumRows + Arow[iNumRows];
+	for (int t = 0; t <= iNumParts; t++)
+	{
+		long diagonal = total * t / iNumParts;
+		int lo = 0;
+		int hi = iNumRows;
+		while (lo < hi)
+		{
+			int mid = lo + (hi - lo) / 2;
+			if ((long) mid + Arow[mid] < diagonal)
+			{
+				lo = mid + 1;
+			}
+			else
+			{
+				hi = mid;
+			}
+		}
+		tPart->rowPtr[t] = lo;
+	}
+
+	int64_t maxNonzeros = 0;
+	for (int t = 0; t < iNumParts; t++)
+	{
+		maxNonzeros = std::max(maxNonzeros, Arow[tPart->rowPtr[t+1]] - Arow[tPart->rowPtr[t]]);
+	}
+	std::cout << "Row partition: " << iNumParts << " blocks, max/avg nonzeros "
+		<< (double) maxNonzeros * iNumParts / std::max<int64_t>(Arow[iNumRows], 1) << std::endl;
+}
+
+void freePartition(ooo_partition *tPart)
+{
+	delete[] tPart->rowPtr;
+}
+
+void spmxvCsrBlock(ooo_partition *tPart, int t, const int64_t *Arow, const int *Acol, const double *Aval, const double *x, double *y)
+{
+	for (int i = tPart->rowPtr[t]; i < tPart->rowPtr[t+1]; i++)
+	{
+		double sum = 0.0;
+
+		#pragma omp simd reduction(+:sum)
+		for (int64_t j = Arow[i]; j < Arow[i+1]; j++)
+		{
+			sum += Aval[j] * x[Acol[j]];
+		}
+
+		y[i] = sum;
+	}
+}
+
+void spmxvCsr(ooo_partition *tPart, const int64_t *Arow, const int *Acol, const double *Aval, const double *x, double *y)
+{
+	#pragma omp parallel num_threads(tPart->iNumParts) proc_bind(spread)
+	{
+		// one block per thread, unless the runtime handed out a smaller team
+		for (int t = omp_get_thread_num(); t < tPart->iNumParts; t += omp_get_num_threads())
+		{
+			spmxvCsrBlock(tPart, t, Arow, Acol, Aval, x, y);
+		}
+	}
+}
+
+/**
+ * NV vectors of a row-major interleaved block with the given row stride,
+ * every nonzero is loaded once and applied to all NV vectors.
+ */
+template<int NV>
+static inline void spmmRows(int rowBeg, int rowEnd, const int64_t *Arow, const int *Acol, const double *Aval, const double * __restrict__ X, double * __restrict__ Y, int stride)
+{
+	for (int i = rowBeg; i < rowEnd; i++)
+	{
+		double sum[NV] = {};
+		for (int64_t j = Arow[i]; j < Arow[i+1]; j++)
+		{
+			const double a = Aval[j];
+			const double * __restrict__ xrow = X + (size_t) Acol[j] * stride;
+
+			#pragma omp simd
+			for (int v = 0; v < NV; v++)
+			{
+				sum[v] += a * xrow[v];
+			}
+		}
+
+		#pragma omp simd
+		for (int v = 0; v < NV; v++)
+		{
+			Y[(size_t) i * stride + v] = sum[v];
+		}
+	}
+}
+
+static void spmmCsrBlock(ooo_partition *tPart, int t, const int64_t *Arow, const int *Acol, const double *Aval, int nv, const double *X, double *Y)
+{
+	int rowBeg = tPart->rowPtr[t];
+	int rowEnd = tPart->rowPtr[t+1];
+
+	switch (nv)
+	{
+	case 1:  spmmRows<1>(rowBeg, rowEnd, Arow, Acol, Aval, X, Y, nv);  break;
+	case 2:  spmmRows<2>(rowBeg, rowEnd, Arow, Acol, Aval, X, Y, nv);  break;
+	case 4:  spmmRows<4>(rowBeg, rowEnd, Arow, Acol, Aval, X, Y, nv);  break;
+	case 8:  spmmRows<8>(rowBeg, rowEnd, Arow, Acol, Aval, X, Y, nv);  break;
+	case 16: spmmRows<16>(rowBeg, rowEnd, Arow, Acol, Aval, X, Y, nv); break;
+	case 32: spmmRows<32>(rowBeg, rowEnd, Arow, Acol, Aval, X, Y, nv); break;
+	default:
+		// other widths: sweep the rows once per group of 16, 8, 4, 2, 1 vectors
+		int v = 0;
+		for (; v + 16 <= nv; v += 16)
+		{
+			spmmRows<16>(rowBeg, rowEnd, Arow, Acol, Aval, X + v, Y + v, nv);
+		}
+		for (; v + 8 <= nv; v += 8)
+		{
+			spmmRows<8>(rowBeg, rowEnd, Arow, Acol, Aval, X + v, Y + v, nv);
+		}
+		for (; v + 4 <= nv; v += 4)
+		{
+			spmmRows<4>(rowBeg, rowEnd, Arow, Acol, Aval, X + v, Y + v, nv);
+		}
+		for (; v + 2 <= nv; v += 2)
+		{
+			spmmRows<2>(rowBeg, rowEnd, Arow, Acol, Aval, X + v, Y + v, nv);
+		}
+		for (; v < nv; v++)
+		{
+			spmmRows<1>(rowBeg, rowEnd, Arow, Acol, Aval, X + v, Y + v, nv);
+		}
+		break;
+	}
+}
+
+void spmmCsr(ooo_partition *tPart, const int64_t *Arow, const int *Acol, const double *Aval, int iNumVectors, const double *X, double *Y)
+{
+	#pragma omp parallel num_threads(tPart->iNumParts) proc_bind(spread)
+	{
+		for (int t = omp_get_thread_num(); t < tPart->iNumParts; t += omp_get_num_threads())
+		{
+			spmmCsrBlock(tPart, t, Arow, Acol, Aval, iNumVectors, X, Y);
+		}
+	}
+}
+
+void spmmCsrReplicated(ooo_partition *tPart, const int64_t *Arow, const int *Acol, const double *Aval, int iNumVectors, const ooo_replicas *tRep, double *Y)
+{
+	#pragma omp parallel num_threads(tPart->iNumParts) proc_bind(spread)
+	{
+		// looked up per call, the thread may have moved since the last one
+		const double *X = localReplica(tRep);
+		for (int t = omp_get_thread_num(); t < tPart->iNumParts; t += omp_get_num_threads())
+		{
+			if (iNumVectors == 1)
+			{
+				spmxvCsrBlock(tPart, t, Arow, Acol, Aval, X, Y);
+			}
+			else
+			{
+				spmmCsrBlock(tPart, t, Arow, Acol, Aval, iNumVectors, X, Y);
+			}
+		}
+	}
+}
+
+void mergePathPartition(const int64_t *Arow, int iNumRows, int iNumParts, ooo_merge_path *tMp)
+{
+	int64_t numNonzeros = Arow[iNumRows];
+	long total = (long) iNumRows + numNonzeros;
+
+	tMp->iNumParts = iNumParts;
+	tMp->rowStart = new int[iNumParts + 1];
+	tMp->nzStart = new int64_t[iNumParts + 1];
+	tMp->carryRow = new int[iNumParts];
+	tMp->carryVal = new double[iNumParts];
+
+	for (int t = 0; t <= iNumParts; t++)
+	{
+		// 2D search along the diagonal: rows consumed are the row ends
+		// Arow[1..n] that are not beyond the nonzeros consumed
+		long diagonal = total * t / iNumParts;
+		long lo = std::max(diagonal - numNonzeros, 0L);
+		long hi = std::min(diagonal, (long) iNumRows);
+		while (lo < hi)
+		{
+			long pivot = (lo + hi) / 2;
+			if (Arow[pivot + 1] <= diagonal - pivot - 1)
+			{
+				lo = pivot + 1;
+			}
+			else
+			{
+				hi = pivot;
+			}
+		}
+		tMp->rowStart[t] = lo;
+		tMp->nzStart[t] = diagonal - lo;
+	}
+}
+
+void spmxvCsrMerge(ooo_merge_path *tMp, const int64_t *Arow, const int *Acol, const double *Aval, const double *x, double *y)
+{
+	#pragma omp parallel num_threads(tMp->iNumParts) proc_bind(spread)
+	{
+		for (int t = omp_get_thread_num(); t < tMp->iNumParts; t += omp_get_num_threads())
+		{
+			int row = tMp->rowStart[t];
+			int64_t nz = tMp->nzStart[t];
+
+			// rows completed by this thread, the first one may lack its head
+			for (; row < tMp->rowStart[t+1]; row++)
+			{
+				double sum = 0.0;
+
+				#pragma omp simd reduction(+:sum)
+				for (int64_t j = nz; j < Arow[row+1]; j++)
+				{
+					sum += Aval[j] * x[Acol[j]];
+				}
+
+				y[row] = sum;
+				nz = Arow[row+1];
+			}
+
+			// head of a row which is completed by a following thread
+			double sum = 0.0;
+			#pragma omp simd reduction(+:sum)
+			for (int64_t j = nz; j < tMp->nzStart[t+1]; j++)
+			{
+				sum += Aval[j] * x[Acol[j]];
+			}
+			tMp->carryRow[t] = row;
+			tMp->carryVal[t] = sum;
+		}
+
+		#pragma omp barrier
+
+		#pragma omp single
+		for (int t = 0; t < tMp->iNumParts - 1; t++)
+		{
+			y[tMp->carryRow[t]] += tMp->carryVal[t];
+		}
+	}
+}
+
+void freeMergePath(ooo_merge_path *tMp)
+{
+	delete[] tMp->rowStart;
+	delete[] tMp->nzStart;
+	delete[] tMp->carryRow;
+	delete[] tMp->carryVal;
+}
+
+void classifyRows(ooo_input *tInput, ooo_partition *tPart, ooo_csr_rl *tRl)
+{
+	int64_t *row = tInput->row;
+	std::vector<ooo_csr_segment> segments;
+	int numFixedRows = 0;
+	int numLongRows = 0;
+
+	// segments never cross partition blocks, so every thread keeps its rows
+	tRl->partSegPtr = new int[tPart->iNumParts + 1];
+	for (int t = 0; t < tPart->iNumParts; t++)
+	{
+		tRl->partSegPtr[t] = segments.size();
+		int n = tPart->rowPtr[t+1];
+		int i = tPart->rowPtr[t];
+		while (i < n)
+		{
+			// find the run of equal-length rows starting at i
+			int64_t len = row[i+1] - row[i];
+			int j = i + 1;
+			while (j < n && j - i < CSR_SEGMENT_ROWS && row[j+1] - row[j] == len)
+			{
+				j++;
+			}
+
+			if (len >= 1 && len <= CSR_MAX_FIXED_LEN && j - i >= CSR_MIN_RUN)
+			{
+				ooo_csr_segment seg = { i, j, (int) len };
+				segments.push_back(seg);
+				numFixedRows += j - i;
+			}
+			else if ((int) segments.size() > tRl->partSegPtr[t] && segments.back().iRowLen == 0 &&
+				j - segments.back().iRowBegin <= CSR_SEGMENT_ROWS)
+			{
+				segments.back().iRowEnd = j;
+			}
+			else
+			{
+				ooo_csr_segment seg = { i, j, 0 };
+				segments.push_back(seg);
+			}
+
+			if (len >= CSR_LONG_ROW_LEN)
+			{
+				numLongRows += j - i;
+			}
+			i = j;
+		}
+	}
+	tRl->partSegPtr[tPart->iNumParts] = segments.size();
+
+	tRl->iNumSegments = segments.size();
+	tRl->segments = new ooo_csr_segment[segments.size()];
+	std::copy(segments.begin(), segments.end(), tRl->segments);
+
+	std::cout << "CSR row-length dispatch: " << tRl->iNumSegments << " segments, "
+		<< numFixedRows << " fixed-length rows, " << numLongRows << " long rows" << std::endl;
+}
+
+void spmxvCsrRowLength(ooo_csr_rl *tRl, ooo_partition *tPart, const int64_t *Arow, const int *Acol, const double *Aval, const double *x, double *y)
+{
+	#pragma omp parallel num_threads(tPart->iNumParts) proc_bind(spread)
+	{
+		for (int t = omp_get_thread_num(); t < tPart->iNumParts; t += omp_get_num_threads())
+		{
+			for (int s = tRl->partSegPtr[t]; s < tRl->partSegPtr[t+1]; s++)
+			{
+				const ooo_csr_segment &seg = tRl->segments[s];
+				segmentKernels[seg.iRowLen](seg, Arow, Acol, Aval, x, y);
+			}
+		}
+	}
+}
+
+void freeCsrRowLength(ooo_csr_rl *tRl)
+{
+	delete[] tRl->segments;
+	delete[] tRl->partSegPtr;
+}
@@ -0,0 +1,77 @@
+#ifndef INC_CSR_H
+#define INC_CSR_H
+
+#include "ooo_cmdline.h"
+#include "replicate.h"
+
+// rows up to this length get a fully unrolled kernel
+#define CSR_MAX_FIXED_LEN 16
+// rows from this length on use the gather kernel
+#define CSR_LONG_ROW_LEN 32
+// minimum number of consecutive equal-length rows for a fixed-length segment
+#define CSR_MIN_RUN 8
+// maximum rows per segment
+#define CSR_SEGMENT_ROWS 512
+
+/**
+ * Static row partition, thread t owns rows rowPtr[t] .. rowPtr[t+1]-1.
+ */
+struct ooo_partition
+{
+	int				iNumParts;
+	int				*rowPtr;
+};
+
+/**
+ * Merge-path split of the combined (rows + nonzeros) sequence, thread t
+ * starts at row rowStart[t] and nonzero nzStart[t]. Rows cut at a thread
+ * boundary are completed from the per-thread carries.
+ */
+struct ooo_merge_path
+{
+	int				iNumParts;
+	int				*rowStart;
+	int64_t			*nzStart;
+	int				*carryRow;
+	double			*carryVal;
+};
+
+/**
+ * Contiguous range of rows handled by one specialised kernel. A row length
+ * of 0 marks a mixed segment which dispatches per row.
+ */
+struct ooo_csr_segment
+{
+	int				iRowBegin;
+	int				iRowEnd;
+	int				iRowLen;
+};
+
+/**
+ * Row-length classification of a CSR matrix, computed once after loading.
+ */
+struct ooo_csr_rl
+{
+	int				iNumSegments;
+	ooo_csr_segment	*segments;
+	int				*partSegPtr;	// segments of partition block t start at partSegPtr[t]
+};
+
+void partitionRows(const int64_t *Arow, int iNumRows, int iNumParts, ooo_partition *tPart);
+void freePartition(ooo_partition *tPart);
+
+void spmxvCsrBlock(ooo_partition *tPart, int t, const int64_t *Arow, const int *Acol, const double *Aval, const double *x, double *y);
+void spmxvCsr(ooo_partition *tPart, const int64_t *Arow, const int *Acol, const double *Aval, const double *x, double *y);
+void spmmCsr(ooo_partition *tPart, const int64_t *Arow, const int *Acol, const double *Aval, int iNumVectors, const double *X, double *Y);
+// every thread gathers from the x replica of its NUMA node
+void spmmCsrReplicated(ooo_partition *tPart, const int64_t *Arow, const int *Acol, const double *Aval, int iNumVectors, const ooo_replicas *tRep, double *Y);
+
+void mergePathPartition(const int64_t *Arow, int iNumRows, int iNumParts, ooo_merge_path *tMp);
+void spmxvCsrMerge(ooo_merge_path *tMp, const int64_t *Arow, const int *Acol, const double *Aval, const double *x, double *y);
+void freeMergePath(ooo_merge_path *tMp);
+
+void classifyRows(ooo_input *tInput, ooo_partition *tPart, ooo_csr_rl *tRl);
+void spmxvCsrRowLength(ooo_csr_rl *tRl, ooo_partition *tPart, const int64_t *Arow, const int *Acol, const double *Aval, const double *x, double *y);
+void freeCsrRowLength(ooo_csr_rl *tRl);
+
+#endif
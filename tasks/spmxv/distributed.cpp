@@ -0,0 +1,790 @@
+#include "distributed.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+#include <omp.h>
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "persistent.h"
+#include "reorder.h"
+#include "ooo_verify.h"
+
+#define DIST_LINE 64
+
+extern char **environ;
+
+// this process in a distributed run, set by initRanks
+static int iProcessRank = 0;
+static char **processArgv = NULL;
+
+#ifndef USE_MPI
+/**
+ * Counter one cache line apart from its neighbours, the shared segment is
+ * zero-filled by ftruncate, which is a valid initial state.
+ */
+struct ooo_shm_flag
+{
+	alignas(DIST_LINE) std::atomic<long>	value;
+};
+
+// generation barrier over the rank processes
+struct ooo_shm_header
+{
+	alignas(DIST_LINE) std::atomic<int>		arrived;
+	alignas(DIST_LINE) std::atomic<long>	generation;
+};
+#endif
+
+struct ooo_transport
+{
+#ifdef USE_MPI
+	MPI_Request			*requests;		// receives, then sends
+#else
+	size_t				stSize;
+	void				*base;
+	ooo_shm_header		*header;
+	ooo_shm_flag		*published;		// published[q]: last iteration whose x entries rank q has written
+	ooo_shm_flag		*consumed;		// consumed[q * R + r]: last iteration rank r has read from rank q
+	double				*times;			// R x repetitions
+	int					*stats;			// halo entries and interior rows per rank
+	double				*window;		// global x, every rank writes the own entries other ranks read
+	double				*y;				// global y
+#endif
+};
+
+void initRanks(int *argc, char ***argv)
+{
+#ifdef USE_MPI
+	MPI_Init(argc, argv);
+	MPI_Comm_rank(MPI_COMM_WORLD, &iProcessRank);
+#else
+	(void) argc;
+	const char *strRank = getenv(DIST_ENV_RANK);
+	if (strRank != NULL)
+	{
+		// do not outlive the launcher
+		prctl(PR_SET_PDEATHSIG, SIGKILL);
+		iProcessRank = atoi(strRank);
+	}
+#endif
+	processArgv = *argv;
+	if (iProcessRank > 0)
+	{
+		freopen("/dev/null", "w", stdout);
+	}
+}
+
+void finalizeRanks()
+{
+#ifdef USE_MPI
+	MPI_Finalize();
+#endif
+}
+
+bool isLauncher()
+{
+#ifdef USE_MPI
+	return false;
+#else
+	return getenv(DIST_ENV_RANK) == NULL;
+#endif
+}
+
+int launchedRanks()
+{
+#ifdef USE_MPI
+	int size;
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	return size;
+#else
+	return 1;
+#endif
+}
+
+int launchRanks(ooo_options *tOptions)
+{
+	int R = tOptions->iNumRanks;
+	char strName[64];
+	snprintf(strName, sizeof(strName), "/ooo_spmxv.%d", (int) getpid());
+	int fd = shm_open(strName, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0)
+	{
+		std::cerr << "ERROR: could not create shared memory " << strName << ": " << strerror(errno) << std::endl;
+		return EXIT_FAILURE;
+	}
+	close(fd);
+
+	// the environment of the ranks, with their rank and the segment name
+	std::vector<std::string> env;
+	for (char **e = environ; *e != NULL; e++)
+	{
+		if (strncmp(*e, DIST_ENV_RANK "=", strlen(DIST_ENV_RANK) + 1) != 0 &&
+			strncmp(*e, DIST_ENV_SHM "=", strlen(DIST_ENV_SHM) + 1) != 0)
+		{
+			env.push_back(*e);
+		}
+	}
+	env.push_back(std::string(DIST_ENV_SHM "=") + strName);
+	env.push_back("");
+
+	// contiguous shares of the allowed cpus, all of them if there are fewer cpus than ranks
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	sched_getaffinity(0, sizeof(allowed), &allowed);
+	std::vector<int> cpus;
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		if (CPU_ISSET(cpu, &allowed))
+		{
+			cpus.push_back(cpu);
+		}
+	}
+	int nc = (int) cpus.size();
+
+	// the ranks run this executable under its own name
+	char strExe[4096];
+	ssize_t len = readlink("/proc/self/exe", strExe, sizeof(strExe) - 1);
+	strExe[std::max<ssize_t>(len, 0)] = '\0';
+
+	std::vector<pid_t> pids(R, -1);
+	int status = EXIT_SUCCESS;
+	for (int r = 0; r < R; r++)
+	{
+		cpu_set_t share = allowed;
+		if (nc >= R)
+		{
+			CPU_ZERO(&share);
+			for (int k = (int) ((long) nc * r / R); k < (int) ((long) nc * (r + 1) / R); k++)
+			{
+				CPU_SET(cpus[k], &share);
+			}
+		}
+		// the rank inherits the mask, its OpenMP places follow from it
+		sched_setaffinity(0, sizeof(share), &share);
+
+		env.back() = std::string(DIST_ENV_RANK "=") + std::to_string(r);
+		std::vector<char*> envp;
+		for (size_t k = 0; k < env.size(); k++)
+		{
+			envp.push_back((char*) env[k].c_str());
+		}
+		envp.push_back(NULL);
+
+		int err = posix_spawn(&pids[r], strExe, NULL, NULL, processArgv, envp.data());
+		if (err != 0)
+		{
+			std::cerr << "ERROR: could not start rank " << r << ": " << strerror(err) << std::endl;
+			pids[r] = -1;
+			status = EXIT_FAILURE;
+			break;
+		}
+	}
+	sched_setaffinity(0, sizeof(allowed), &allowed);
+
+	// a failing rank takes the others down, they would wait for it forever
+	int running = 0;
+	for (int r = 0; r < R; r++)
+	{
+		running += pids[r] > 0;
+	}
+	if (status != EXIT_SUCCESS)
+	{
+		for (int r = 0; r < R; r++)
+		{
+			if (pids[r] > 0)
+			{
+				kill(pids[r], SIGKILL);
+			}
+		}
+	}
+	while (running > 0)
+	{
+		int st;
+		pid_t pid = wait(&st);
+		if (pid < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+		int r = (int) (std::find(pids.begin(), pids.end(), pid) - pids.begin());
+		if (r == R)
+		{
+			continue;
+		}
+		pids[r] = -1;
+		running--;
+		if (! WIFEXITED(st) || WEXITSTATUS(st) != EXIT_SUCCESS)
+		{
+			if (status == EXIT_SUCCESS && WIFSIGNALED(st))
+			{
+				std::cerr << "ERROR: rank " << r << " terminated by signal " << WTERMSIG(st) << std::endl;
+			}
+			if (status == EXIT_SUCCESS)
+			{
+				for (int q = 0; q < R; q++)
+				{
+					if (pids[q] > 0)
+					{
+						kill(pids[q], SIGKILL);
+					}
+				}
+			}
+			status = EXIT_FAILURE;
+		}
+	}
+
+	shm_unlink(strName);
+	return status;
+}
+
+// rank of global column c, ranks own ascending contiguous blocks
+static int ownerOf(const ooo_partition *tRanks, int c)
+{
+	return (int) (std::upper_bound(tRanks->rowPtr, tRanks->rowPtr + tRanks->iNumParts + 1, c) - tRanks->rowPtr) - 1;
+}
+
+/**
+ * Own block, halo lists, interior/boundary split and the local CSR arrays,
+ * first touched in the partition order of the kernels.
+ */
+static void buildRank(ooo_input *tInput, int iRank, int iNumRanks, ooo_dist_rank *R)
+{
+	R->iRank = iRank;
+	R->iNumRanks = iNumRanks;
+	partitionRows(tInput->row, tInput->stNumRows, iNumRanks, &R->tRanks);
+	int b = R->tRanks.rowPtr[iRank];
+	int e = R->tRanks.rowPtr[iRank + 1];
+	int n = e - b;
+	R->iNumRows = n;
+
+	// remote columns of the own rows, sorted by global index and hence grouped by owner
+	std::vector<int> halo;
+	std::vector<char> interior(n, 1);
+	for (int i = b; i < e; i++)
+	{
+		for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1]; nz++)
+		{
+			int c = tInput->col[nz];
+			if (c < b || c >= e)
+			{
+				halo.push_back(c);
+				interior[i - b] = 0;
+			}
+		}
+	}
+	std::sort(halo.begin(), halo.end());
+	halo.erase(std::unique(halo.begin(), halo.end()), halo.end());
+	R->iNumHalo = (int) halo.size();
+	R->recvIdx = new int[std::max(R->iNumHalo, 1)];
+	std::copy(halo.begin(), halo.end(), R->recvIdx);
+	std::vector<int> recvRank, recvPtr;
+	for (int k = 0; k < R->iNumHalo; k++)
+	{
+		int q = ownerOf(&R->tRanks, halo[k]);
+		if (recvRank.empty() || recvRank.back() != q)
+		{
+			recvRank.push_back(q);
+			recvPtr.push_back(k);
+		}
+	}
+	recvPtr.push_back(R->iNumHalo);
+	R->iNumRecv = (int) recvRank.size();
+	R->recvRank = new int[std::max(R->iNumRecv, 1)];
+	R->recvPtr = new int[R->iNumRecv + 1];
+	std::copy(recvRank.begin(), recvRank.end(), R->recvRank);
+	std::copy(recvPtr.begin(), recvPtr.end(), R->recvPtr);
+
+	// interior rows first, both in their original order
+	R->rowOrder = new int[std::max(n, 1)];
+	R->iNumInterior = 0;
+	for (int i = 0; i < n; i++)
+	{
+		if (interior[i])
+		{
+			R->rowOrder[R->iNumInterior++] = i;
+		}
+	}
+	for (int i = 0, s = R->iNumInterior; i < n; i++)
+	{
+		if (! interior[i])
+		{
+			R->rowOrder[s++] = i;
+		}
+	}
+	int nb = n - R->iNumInterior;
+	int ni = R->iNumInterior;
+
+	R->irow = R->tMemory.allocateNuma<int64_t>(ni + 1);
+	R->brow = R->tMemory.allocateNuma<int64_t>(nb + 1);
+	R->irow[0] = 0;
+	R->brow[0] = 0;
+	for (int s = 0; s < n; s++)
+	{
+		int g = b + R->rowOrder[s];
+		int64_t len = tInput->row[g+1] - tInput->row[g];
+		if (s < ni)
+		{
+			R->irow[s + 1] = R->irow[s] + len;
+		}
+		else
+		{
+			R->brow[s - ni + 1] = R->brow[s - ni] + len;
+		}
+	}
+	int nt = omp_get_max_threads();
+	partitionRows(R->irow, ni, nt, &R->tInterior);
+	partitionRows(R->brow, nb, nt, &R->tBoundary);
+	R->icol = R->tMemory.allocateNuma<int>(R->irow[ni]);
+	R->ival = R->tMemory.allocateNuma<double>(R->irow[ni]);
+	R->bcol = R->tMemory.allocateNuma<int>(R->brow[nb]);
+	R->bval = R->tMemory.allocateNuma<double>(R->brow[nb]);
+	R->y = R->tMemory.allocateNuma<double>(n);
+	R->x = R->tMemory.allocateInterleaved<double>(n + R->iNumHalo);
+
+	#pragma omp parallel num_threads(nt) proc_bind(spread)
+	{
+		for (int t = omp_get_thread_num(); t < nt; t += omp_get_num_threads())
+		{
+			for (int s = R->tInterior.rowPtr[t]; s < R->tInterior.rowPtr[t+1]; s++)
+			{
+				int g = b + R->rowOrder[s];
+				for (int64_t nz = tInput->row[g], j = R->irow[s]; nz < tInput->row[g+1]; nz++, j++)
+				{
+					R->icol[j] = tInput->col[nz] - b;
+					R->ival[j] = tInput->val[nz];
+				}
+				R->y[s] = 0.0;
+			}
+			for (int s = R->tBoundary.rowPtr[t]; s < R->tBoundary.rowPtr[t+1]; s++)
+			{
+				int g = b + R->rowOrder[ni + s];
+				for (int64_t nz = tInput->row[g], j = R->brow[s]; nz < tInput->row[g+1]; nz++, j++)
+				{
+					int c = tInput->col[nz];
+					R->bcol[j] = (c >= b && c < e) ? c - b :
+						n + (int) (std::lower_bound(R->recvIdx, R->recvIdx + R->iNumHalo, c) - R->recvIdx);
+					R->bval[j] = tInput->val[nz];
+				}
+				R->y[ni + s] = 0.0;
+			}
+		}
+	}
+
+	for (int i = 0; i < n; i++)
+	{
+		R->x[i] = (tInput->x != NULL) ? tInput->x[b + i] : 1.0;
+	}
+	for (int k = 0; k < R->iNumHalo; k++)
+	{
+		R->x[n + k] = 0.0;
+	}
+}
+
+/**
+ * Send lists: the own entries every other rank reads. With MPI the ranks
+ * tell each other their receive lists, the shared-memory ranks scan the
+ * rows of the other ranks in the global matrix they all hold.
+ */
+static void buildSendLists(ooo_input *tInput, ooo_dist_rank *R)
+{
+	int P = R->iNumRanks;
+	int b = R->tRanks.rowPtr[R->iRank];
+	std::vector<std::vector<int> > lists(P);
+#ifdef USE_MPI
+	std::vector<int> recvCount(P, 0), sendCount(P), recvDispl(P, 0), sendDispl(P, 0);
+	for (int k = 0; k < R->iNumRecv; k++)
+	{
+		recvCount[R->recvRank[k]] = R->recvPtr[k+1] - R->recvPtr[k];
+		recvDispl[R->recvRank[k]] = R->recvPtr[k];
+	}
+	MPI_Alltoall(recvCount.data(), 1, MPI_INT, sendCount.data(), 1, MPI_INT, MPI_COMM_WORLD);
+	int requests = 0;
+	for (int q = 0; q < P; q++)
+	{
+		sendDispl[q] = requests;
+		requests += sendCount[q];
+	}
+	std::vector<int> requested(std::max(requests, 1));
+	MPI_Alltoallv(R->recvIdx, recvCount.data(), recvDispl.data(), MPI_INT,
+		requested.data(), sendCount.data(), sendDispl.data(), MPI_INT, MPI_COMM_WORLD);
+	for (int q = 0; q < P; q++)
+	{
+		for (int k = sendDispl[q]; k < sendDispl[q] + sendCount[q]; k++)
+		{
+			lists[q].push_back(requested[k] - b);
+		}
+	}
+#else
+	int e = R->tRanks.rowPtr[R->iRank + 1];
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int q = 0; q < P; q++)
+	{
+		if (q == R->iRank)
+		{
+			continue;
+		}
+		for (int64_t nz = tInput->row[R->tRanks.rowPtr[q]]; nz < tInput->row[R->tRanks.rowPtr[q+1]]; nz++)
+		{
+			int c = tInput->col[nz];
+			if (c >= b && c < e)
+			{
+				lists[q].push_back(c - b);
+			}
+		}
+		std::sort(lists[q].begin(), lists[q].end());
+		lists[q].erase(std::unique(lists[q].begin(), lists[q].end()), lists[q].end());
+	}
+#endif
+
+	R->iNumSend = 0;
+	int total = 0;
+	for (int q = 0; q < P; q++)
+	{
+		R->iNumSend += ! lists[q].empty();
+		total += (int) lists[q].size();
+	}
+	R->sendRank = new int[std::max(R->iNumSend, 1)];
+	R->sendPtr = new int[R->iNumSend + 1];
+	R->sendIdx = new int[std::max(total, 1)];
+	R->sendBuf = new double[std::max(total, 1)];
+	R->sendPtr[0] = 0;
+	for (int q = 0, k = 0; q < P; q++)
+	{
+		if (! lists[q].empty())
+		{
+			R->sendRank[k] = q;
+			std::copy(lists[q].begin(), lists[q].end(), R->sendIdx + R->sendPtr[k]);
+			R->sendPtr[k+1] = R->sendPtr[k] + (int) lists[q].size();
+			k++;
+		}
+	}
+}
+
+static void freeRank(ooo_dist_rank *R)
+{
+	R->tMemory.release();
+	freePartition(&R->tRanks);
+	freePartition(&R->tInterior);
+	freePartition(&R->tBoundary);
+	delete[] R->rowOrder;
+	delete[] R->recvRank;
+	delete[] R->recvPtr;
+	delete[] R->recvIdx;
+	delete[] R->sendRank;
+	delete[] R->sendPtr;
+	delete[] R->sendIdx;
+	delete[] R->sendBuf;
+}
+
+#ifndef USE_MPI
+// spins, then leaves the core to the other ranks
+static void waitFor(const std::atomic<long> &flag, long value)
+{
+	for (int spins = 0; flag.load(std::memory_order_acquire) < value; spins++)
+	{
+		if (spins >= BARRIER_SPINS)
+		{
+			sched_yield();
+		}
+	}
+}
+
+static bool attachSegment(ooo_dist_rank *R, int n, int iNumRepetitions)
+{
+	ooo_transport *T = R->tComm;
+	int P = R->iNumRanks;
+	const char *strName = getenv(DIST_ENV_SHM);
+	size_t offPublished = sizeof(ooo_shm_header);
+	size_t offConsumed = offPublished + sizeof(ooo_shm_flag) * P;
+	size_t offTimes = offConsumed + sizeof(ooo_shm_flag) * P * P;
+	size_t offStats = offTimes + sizeof(double) * P * iNumRepetitions;
+	size_t offWindow = offStats + ((sizeof(int) * 2 * P + DIST_LINE - 1) / DIST_LINE) * DIST_LINE;
+	size_t offY = offWindow + sizeof(double) * n;
+	T->stSize = offY + sizeof(double) * std::max(n, 1);
+
+	// every rank sizes the segment the same way, the first ftruncate zero-fills it
+	int fd = (strName != NULL) ? shm_open(strName, O_RDWR, 0600) : -1;
+	if (fd < 0 || ftruncate(fd, T->stSize) != 0)
+	{
+		std::cerr << "ERROR: rank " << R->iRank << " could not open the shared memory of the launcher" << std::endl;
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		return false;
+	}
+	T->base = mmap(NULL, T->stSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (T->base == MAP_FAILED)
+	{
+		std::cerr << "ERROR: rank " << R->iRank << " could not map the shared memory" << std::endl;
+		return false;
+	}
+	char *base = (char*) T->base;
+	T->header = (ooo_shm_header*) base;
+	T->published = (ooo_shm_flag*) (base + offPublished);
+	T->consumed = (ooo_shm_flag*) (base + offConsumed);
+	T->times = (double*) (base + offTimes);
+	T->stats = (int*) (base + offStats);
+	T->window = (double*) (base + offWindow);
+	T->y = (double*) (base + offY);
+	return true;
+}
+#endif
+
+static void rankBarrier(ooo_dist_rank *R)
+{
+#ifdef USE_MPI
+	MPI_Barrier(MPI_COMM_WORLD);
+#else
+	ooo_shm_header *h = R->tComm->header;
+	long gen = h->generation.load(std::memory_order_acquire);
+	if (h->arrived.fetch_add(1, std::memory_order_acq_rel) == R->iNumRanks - 1)
+	{
+		h->arrived.store(0, std::memory_order_relaxed);
+		h->generation.store(gen + 1, std::memory_order_release);
+	}
+	else
+	{
+		waitFor(h->generation, gen + 1);
+	}
+#endif
+}
+
+/**
+ * Posts iteration it of the halo exchange: MPI receives straight into the
+ * halo and sends of the packed entries, or the own entries other ranks
+ * read written to the shared x window once their readers are done with
+ * the previous iteration.
+ */
+static void startExchange(ooo_dist_rank *R, long it)
+{
+	ooo_transport *T = R->tComm;
+	for (int j = 0; j < R->sendPtr[R->iNumSend]; j++)
+	{
+		R->sendBuf[j] = R->x[R->sendIdx[j]];
+	}
+#ifdef USE_MPI
+	for (int k = 0; k < R->iNumRecv; k++)
+	{
+		MPI_Irecv(R->x + R->iNumRows + R->recvPtr[k], R->recvPtr[k+1] - R->recvPtr[k], MPI_DOUBLE,
+			R->recvRank[k], 0, MPI_COMM_WORLD, &T->requests[k]);
+	}
+	for (int k = 0; k < R->iNumSend; k++)
+	{
+		MPI_Isend(R->sendBuf + R->sendPtr[k], R->sendPtr[k+1] - R->sendPtr[k], MPI_DOUBLE,
+			R->sendRank[k], 0, MPI_COMM_WORLD, &T->requests[R->iNumRecv + k]);
+	}
+#else
+	int b = R->tRanks.rowPtr[R->iRank];
+	for (int k = 0; k < R->iNumSend; k++)
+	{
+		waitFor(T->consumed[R->iRank * R->iNumRanks + R->sendRank[k]].value, it - 1);
+	}
+	for (int j = 0; j < R->sendPtr[R->iNumSend]; j++)
+	{
+		T->window[b + R->sendIdx[j]] = R->sendBuf[j];
+	}
+	T->published[R->iRank].value.store(it, std::memory_order_release);
+#endif
+}
+
+// completes iteration it, the halo is valid afterwards
+static void finishExchange(ooo_dist_rank *R, long it)
+{
+	ooo_transport *T = R->tComm;
+#ifdef USE_MPI
+	MPI_Waitall(R->iNumRecv + R->iNumSend, T->requests, MPI_STATUSES_IGNORE);
+#else
+	for (int k = 0; k < R->iNumRecv; k++)
+	{
+		int q = R->recvRank[k];
+		waitFor(T->published[q].value, it);
+		for (int j = R->recvPtr[k]; j < R->recvPtr[k+1]; j++)
+		{
+			R->x[R->iNumRows + j] = T->window[R->recvIdx[j]];
+		}
+		T->consumed[q * R->iNumRanks + R->iRank].value.store(it, std::memory_order_release);
+	}
+#endif
+}
+
+bool distributedBenchmark(ooo_options *tOptions, ooo_input *tInput)
+{
+	int iNumRepetitions = tOptions->iNumRepetitions;
+	int P = tOptions->iNumRanks;
+	int N = tInput->stNumRows;
+#ifdef USE_MPI
+	if (launchedRanks() != P)
+	{
+		std::cerr << "ERROR: started with " << launchedRanks() << " MPI processes, but --ranks " << P << std::endl;
+		return false;
+	}
+#endif
+
+	// every rank permutes its copy of the global matrix the same way
+	ooo_reorder tReorder;
+	bool bReordered = tOptions->reorder != REORDER_NONE && reorderMatrix(tInput, tOptions->reorder, &tReorder);
+
+	ooo_dist_rank R;
+	ooo_transport tComm;
+	R.tComm = &tComm;
+	buildRank(tInput, iProcessRank, P, &R);
+	buildSendLists(tInput, &R);
+#ifdef USE_MPI
+	tComm.requests = new MPI_Request[R.iNumRecv + R.iNumSend + 1];
+#else
+	if (! attachSegment(&R, N, iNumRepetitions))
+	{
+		return false;
+	}
+#endif
+
+	timespan *timings = (timespan*) malloc(sizeof(timespan) * iNumRepetitions);
+	double *local = new double[iNumRepetitions];
+	double t1, t2;
+
+	rankBarrier(&R);
+	t1 = omp_get_wtime();
+
+	for (int rep = 0; rep < iNumRepetitions; rep++)
+	{
+		// all ranks start together, a repetition takes as long as its slowest rank
+		rankBarrier(&R);
+		double dBegin = omp_get_wtime();
+
+		startExchange(&R, rep + 1);
+		spmxvCsr(&R.tInterior, R.irow, R.icol, R.ival, R.x, R.y);
+		finishExchange(&R, rep + 1);
+		spmxvCsr(&R.tBoundary, R.brow, R.bcol, R.bval, R.x, R.y + R.iNumInterior);
+
+		local[rep] = omp_get_wtime() - dBegin;
+	}
+
+	rankBarrier(&R);
+	t2 = omp_get_wtime();
+
+	// slowest rank per repetition, halo statistics and y on rank 0
+	int stats[2] = { R.iNumHalo, R.iNumInterior };
+	std::vector<int> allStats(2 * P);
+	std::vector<double> slowest(iNumRepetitions);
+	double *y = NULL;
+#ifdef USE_MPI
+	std::vector<double> yOwn(std::max(R.iNumRows, 1));
+	for (int s = 0; s < R.iNumRows; s++)
+	{
+		yOwn[R.rowOrder[s]] = R.y[s];
+	}
+	std::vector<int> counts(P), displs(P);
+	for (int q = 0; q < P; q++)
+	{
+		counts[q] = R.tRanks.rowPtr[q+1] - R.tRanks.rowPtr[q];
+		displs[q] = R.tRanks.rowPtr[q];
+	}
+	std::vector<double> yGlobal(R.iRank == 0 ? std::max(N, 1) : 1);
+	MPI_Gatherv(yOwn.data(), R.iNumRows, MPI_DOUBLE, yGlobal.data(), counts.data(), displs.data(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+	MPI_Reduce(local, slowest.data(), iNumRepetitions, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+	MPI_Gather(stats, 2, MPI_INT, allStats.data(), 2, MPI_INT, 0, MPI_COMM_WORLD);
+	y = yGlobal.data();
+#else
+	int b = R.tRanks.rowPtr[R.iRank];
+	for (int s = 0; s < R.iNumRows; s++)
+	{
+		tComm.y[b + R.rowOrder[s]] = R.y[s];
+	}
+	for (int rep = 0; rep < iNumRepetitions; rep++)
+	{
+		tComm.times[R.iRank * iNumRepetitions + rep] = local[rep];
+	}
+	tComm.stats[2 * R.iRank] = stats[0];
+	tComm.stats[2 * R.iRank + 1] = stats[1];
+	rankBarrier(&R);
+	for (int rep = 0; rep < iNumRepetitions; rep++)
+	{
+		slowest[rep] = 0.0;
+		for (int q = 0; q < P; q++)
+		{
+			slowest[rep] = std::max(slowest[rep], tComm.times[q * iNumRepetitions + rep]);
+		}
+	}
+	std::copy(tComm.stats, tComm.stats + 2 * P, allStats.begin());
+	y = tComm.y;
+#endif
+
+	bool bCorrect = true;
+	if (R.iRank == 0)
+	{
+		int minHalo = allStats[0], maxHalo = allStats[0];
+		long sumHalo = 0, sumInterior = 0;
+		for (int q = 0; q < P; q++)
+		{
+			minHalo = std::min(minHalo, allStats[2 * q]);
+			maxHalo = std::max(maxHalo, allStats[2 * q]);
+			sumHalo += allStats[2 * q];
+			sumInterior += allStats[2 * q + 1];
+		}
+		std::cout << "Distributed: " << P << " ranks over " <<
+#ifdef USE_MPI
+			"MPI"
+#else
+			"shared memory"
+#endif
+			<< ", halo entries per rank min " << minHalo << " mean " << (double) sumHalo / P << " max " << maxHalo
+			<< ", interior rows " << 100.0 * sumInterior / std::max(N, 1) << "%" << std::endl;
+
+		for (int rep = 0; rep < iNumRepetitions; rep++)
+		{
+			timings[rep].dBegin = 0.0;
+			timings[rep].dEnd = slowest[rep];
+		}
+
+		if (tOptions->verify)
+		{
+			std::vector<double> x(std::max(N, 1), 1.0);
+			if (tInput->x != NULL)
+			{
+				std::copy(tInput->x, tInput->x + N, x.begin());
+			}
+			bCorrect = verifyResult(tOptions, tInput, x.data(), y);
+		}
+		print_performance_results(tOptions, t1, t2, timings, tInput, NULL, NULL);
+	}
+
+	// rank 0 reads the segment until here
+	rankBarrier(&R);
+#ifdef USE_MPI
+	delete[] tComm.requests;
+#else
+	munmap(tComm.base, tComm.stSize);
+#endif
+	freeRank(&R);
+	if (bReordered)
+	{
+		freeReorder(&tReorder);
+	}
+	delete[] local;
+	free(timings);
+	return bCorrect;
+}
@@ -0,0 +1,92 @@
+#ifndef INC_DISTRIBUTED_H
+#define INC_DISTRIBUTED_H
+
+#include "ooo_cmdline.h"
+#include "csr.h"
+
+// environment of the rank processes started by the shared-memory launcher
+#define DIST_ENV_RANK "OOO_RANK"
+#define DIST_ENV_SHM "OOO_SHM"
+
+// transport state, MPI requests or the mapped shared-memory segment
+struct ooo_transport;
+
+/**
+ * Rows of one rank of a distributed SpMV. The global rows are split into
+ * contiguous nonzero-balanced blocks, one per rank. The local x holds the
+ * own entries first, followed by the halo: the remote entries the own rows
+ * read, grouped by owner rank and sorted by global index. Own rows reading
+ * only own entries (interior) are stored apart from the others (boundary),
+ * so the interior product runs while the halo is in flight. tMemory owns the
+ * matrix blocks, x and y.
+ */
+struct ooo_dist_rank
+{
+	int				iRank;
+	int				iNumRanks;
+	ooo_partition	tRanks;			// rank r owns global rows tRanks.rowPtr[r] .. tRanks.rowPtr[r+1]-1
+	int				iNumRows;		// own rows
+	int				iNumHalo;
+	int				iNumInterior;
+	int				*rowOrder;		// own row of stored row s, interior rows first
+	ooo_partition	tInterior;
+	int64_t			*irow;
+	int				*icol;
+	double			*ival;
+	ooo_partition	tBoundary;
+	int64_t			*brow;
+	int				*bcol;			// columns in the local x numbering
+	double			*bval;
+	int				iNumRecv;
+	int				*recvRank;
+	int				*recvPtr;		// halo entries of recvRank[k] are x[iNumRows + recvPtr[k]] ..
+	int				*recvIdx;		// their global indices
+	int				iNumSend;
+	int				*sendRank;
+	int				*sendPtr;
+	int				*sendIdx;		// own entries sendRank[k] reads, as local indices
+	double			*sendBuf;
+	double			*x;
+	double			*y;				// stored row order
+	ooo_transport	*tComm;
+	ooo_memory		tMemory;
+};
+
+/**
+ * Joins the distributed run this process was started for: MPI_Init with
+ * USE_MPI, otherwise the rank handed down by launchRanks in the
+ * environment. Ranks other than 0 write no stdout.
+ */
+void initRanks(int *argc, char ***argv);
+void finalizeRanks();
+
+/**
+ * True for the process that has to start the ranks of the shared-memory
+ * transport itself, i.e. without USE_MPI and not started by launchRanks.
+ */
+bool isLauncher();
+
+// number of MPI processes, 1 for the shared-memory transport
+int launchedRanks();
+
+/**
+ * Starts tOptions->iNumRanks copies of this program as rank processes,
+ * each bound to its share of the allowed cpus, and waits for them. The
+ * ranks map a shared-memory segment named in the environment. If a rank
+ * fails, the others are killed.
+ * @return the exit status for main
+ */
+int launchRanks(ooo_options *tOptions);
+
+/**
+ * Distributed SpMV benchmark on the row block of this rank. Every rank
+ * holds the loaded (and possibly reordered) global matrix and derives its
+ * block and halo lists from it. Every repetition posts the halo exchange,
+ * multiplies the interior rows, completes the exchange and multiplies the
+ * boundary rows. The time of a repetition is the slowest rank's, y is
+ * gathered on rank 0 for the check.
+ * @return false on errors or a failed check
+ */
+bool distributedBenchmark(ooo_options *tOptions, ooo_input *tInput);
+
+#endif
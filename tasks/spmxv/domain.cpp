@@ -0,0 +1,178 @@
+#include "domain.h"
+
+#include <sched.h>
+#include <string.h>
+
+#include <omp.h>
+#include <numa.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+bool convertToDomains(ooo_input *tInput, ooo_partition *tPart, const double *x, ooo_domain_csr *tDom)
+{
+	if (numa_available() < 0)
+	{
+		std::cerr << "ERROR: NUMA domains need NUMA support" << std::endl;
+		return false;
+	}
+
+	// allowed cpus per node
+	int maxNode = numa_max_node();
+	std::vector<int> nodeCpus(maxNode + 1, 0);
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	sched_getaffinity(0, sizeof(mask), &mask);
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		int node = CPU_ISSET(cpu, &mask) ? numa_node_of_cpu(cpu) : -1;
+		if (node >= 0 && node <= maxNode)
+		{
+			nodeCpus[node]++;
+		}
+	}
+	std::vector<int> nodes;
+	std::vector<long> cumCpus(1, 0);
+	for (int node = 0; node <= maxNode; node++)
+	{
+		if (nodeCpus[node] > 0)
+		{
+			nodes.push_back(node);
+			cumCpus.push_back(cumCpus.back() + nodeCpus[node]);
+		}
+	}
+	if (nodes.empty())
+	{
+		std::cerr << "ERROR: no NUMA node with allowed cpus" << std::endl;
+		return false;
+	}
+
+	// thread t goes to the node covering its share of the cpus, nodes without threads are dropped
+	int T = tPart->iNumParts;
+	long total = cumCpus.back();
+	std::vector<int> nodeOfThread(T);
+	for (int t = 0; t < T; t++)
+	{
+		long pos = (2L * t + 1) * total / (2L * T);
+		nodeOfThread[t] = (int) (std::upper_bound(cumCpus.begin(), cumCpus.end(), pos) - cumCpus.begin()) - 1;
+	}
+
+	tDom->iNumThreads = T;
+	tDom->threadDomain = new int[T];
+	tDom->domains = new ooo_domain[nodes.size()];
+	tDom->iNumDomains = 0;
+	for (int t = 0; t < T; t++)
+	{
+		if (t == 0 || nodeOfThread[t] != nodeOfThread[t-1])
+		{
+			ooo_domain &D = tDom->domains[tDom->iNumDomains++];
+			D.iNode = nodes[nodeOfThread[t]];
+			D.iFirstThread = t;
+			D.iNumThreads = 0;
+		}
+		tDom->domains[tDom->iNumDomains - 1].iNumThreads++;
+		tDom->threadDomain[t] = tDom->iNumDomains - 1;
+	}
+
+	// node-local slices
+	int n = tInput->stNumRows;
+	for (int d = 0; d < tDom->iNumDomains; d++)
+	{
+		ooo_domain &D = tDom->domains[d];
+		D.iRowBegin = tPart->rowPtr[D.iFirstThread];
+		D.iRowEnd = tPart->rowPtr[D.iFirstThread + D.iNumThreads];
+		int rows = D.iRowEnd - D.iRowBegin;
+		D.stNumNonzeros = tInput->row[D.iRowEnd] - tInput->row[D.iRowBegin];
+		D.stXSize = sizeof(double) * std::max(n, 1);
+		D.tPart.iNumParts = D.iNumThreads;
+		D.tPart.rowPtr = new int[D.iNumThreads + 1];
+		for (int k = 0; k <= D.iNumThreads; k++)
+		{
+			D.tPart.rowPtr[k] = tPart->rowPtr[D.iFirstThread + k] - D.iRowBegin;
+		}
+		D.row = (int64_t*) numa_alloc_onnode(sizeof(int64_t) * (rows + 1), D.iNode);
+		D.col = (int*) numa_alloc_onnode(sizeof(int) * std::max<size_t>(D.stNumNonzeros, 1), D.iNode);
+		D.val = (double*) numa_alloc_onnode(sizeof(double) * std::max<size_t>(D.stNumNonzeros, 1), D.iNode);
+		D.y = (double*) numa_alloc_onnode(sizeof(double) * std::max(rows, 1), D.iNode);
+		D.x = (double*) numa_alloc_onnode(D.stXSize, D.iNode);
+		D.row[rows] = D.stNumNonzeros;
+	}
+
+	// bind every thread to its node, then fill the own rows and a chunk of the x copy
+	#pragma omp parallel num_threads(T)
+	{
+		for (int t = omp_get_thread_num(); t < T; t += omp_get_num_threads())
+		{
+			ooo_domain &D = tDom->domains[tDom->threadDomain[t]];
+			numa_run_on_node(D.iNode);
+
+			int k = t - D.iFirstThread;
+			int64_t base = tInput->row[D.iRowBegin];
+			for (int i = D.tPart.rowPtr[k]; i < D.tPart.rowPtr[k+1]; i++)
+			{
+				int g = D.iRowBegin + i;
+				D.row[i] = tInput->row[g] - base;
+				for (int64_t nz = tInput->row[g]; nz < tInput->row[g+1]; nz++)
+				{
+					D.col[nz - base] = tInput->col[nz];
+					D.val[nz - base] = tInput->val[nz];
+				}
+				D.y[i] = 0.0;
+			}
+			int xBeg = (int) ((long) n * k / D.iNumThreads);
+			int xEnd = (int) ((long) n * (k + 1) / D.iNumThreads);
+			memcpy(D.x + xBeg, x + xBeg, sizeof(double) * (xEnd - xBeg));
+		}
+	}
+
+	std::cout << "NUMA domains:";
+	for (int d = 0; d < tDom->iNumDomains; d++)
+	{
+		ooo_domain &D = tDom->domains[d];
+		std::cout << " node " << D.iNode << " (" << D.iNumThreads << " threads, rows "
+			<< D.iRowBegin << ".." << D.iRowEnd - 1 << ")";
+	}
+	std::cout << std::endl;
+	return true;
+}
+
+void spmxvDomains(ooo_domain_csr *tDom)
+{
+	// no proc_bind, the threads keep the node binding of convertToDomains
+	#pragma omp parallel num_threads(tDom->iNumThreads)
+	{
+		for (int t = omp_get_thread_num(); t < tDom->iNumThreads; t += omp_get_num_threads())
+		{
+			ooo_domain &D = tDom->domains[tDom->threadDomain[t]];
+			spmxvCsrBlock(&D.tPart, t - D.iFirstThread, D.row, D.col, D.val, D.x, D.y);
+		}
+	}
+}
+
+void gatherDomains(ooo_domain_csr *tDom, double *y)
+{
+	#pragma omp parallel for schedule(static, 1)
+	for (int d = 0; d < tDom->iNumDomains; d++)
+	{
+		ooo_domain &D = tDom->domains[d];
+		memcpy(y + D.iRowBegin, D.y, sizeof(double) * (D.iRowEnd - D.iRowBegin));
+	}
+}
+
+void freeDomains(ooo_domain_csr *tDom)
+{
+	for (int d = 0; d < tDom->iNumDomains; d++)
+	{
+		ooo_domain &D = tDom->domains[d];
+		int rows = D.iRowEnd - D.iRowBegin;
+		numa_free(D.row, sizeof(int64_t) * (rows + 1));
+		numa_free(D.col, sizeof(int) * std::max<size_t>(D.stNumNonzeros, 1));
+		numa_free(D.val, sizeof(double) * std::max<size_t>(D.stNumNonzeros, 1));
+		numa_free(D.y, sizeof(double) * std::max(rows, 1));
+		numa_free(D.x, D.stXSize);
+		freePartition(&D.tPart);
+	}
+	delete[] tDom->domains;
+	delete[] tDom->threadDomain;
+}
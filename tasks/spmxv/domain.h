@@ -0,0 +1,51 @@
+#ifndef INC_DOMAIN_H
+#define INC_DOMAIN_H
+
+#include "ooo_cmdline.h"
+#include "csr.h"
+
+/**
+ * Slice of a CSR matrix owned by one NUMA node: rows iRowBegin ..
+ * iRowEnd-1 with node-local row pointers (relative to the slice), columns,
+ * values, y and a full copy of x. Its threads are iFirstThread ..
+ * tFirstThread + iNumThreads - 1 of the team, tPart splits the slice among
+ * them in local row numbers.
+ */
+struct ooo_domain
+{
+	int				iNode;
+	int				iRowBegin;
+	int				iRowEnd;
+	int				iFirstThread;
+	int				iNumThreads;
+	ooo_partition	tPart;
+	int64_t			*row;
+	int				*col;
+	double			*val;
+	double			*x;
+	double			*y;
+	size_t			stNumNonzeros;
+	size_t			stXSize;		// bytes
+};
+
+struct ooo_domain_csr
+{
+	int				iNumDomains;
+	int				iNumThreads;
+	ooo_domain		*domains;
+	int				*threadDomain;	// domain of team thread t
+};
+
+/**
+ * Splits the nonzero-balanced row partition tPart into one slice per NUMA
+ * node with allowed cpus, threads proportional to the node's cpus, and
+ * binds team thread t to its node. The kernel relies on the runtime
+ * reusing the same threads for teams of tPart->iNumParts threads.
+ */
+bool convertToDomains(ooo_input *tInput, ooo_partition *tPart, const double *x, ooo_domain_csr *tDom);
+void spmxvDomains(ooo_domain_csr *tDom);
+// copies the y slices into the global y
+void gatherDomains(ooo_domain_csr *tDom, double *y);
+void freeDomains(ooo_domain_csr *tDom);
+
+#endif
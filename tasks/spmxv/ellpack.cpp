@@ -0,0 +1,259 @@
+#include "ellpack.h"
+
+#include <omp.h>
+#include <numa.h>
+
+#include <algorithm>
+#include <iostream>
+#include <new>
+
+// padded entries reuse the last real column of their row to stay in cache
+static inline int paddingColumn(ooo_input *tInput, int i)
+{
+	int64_t rowbeg = tInput->row[i];
+	int64_t rowend = tInput->row[i+1];
+	return (rowend > rowbeg) ? tInput->col[rowend - 1] : 0;
+}
+
+bool convertToEllpack(ooo_input *tInput, ooo_ellpack *tEll)
+{
+	int n = tInput->stNumRows;
+	int width = 0;
+
+	#pragma omp parallel for schedule(static) reduction(max:width)
+	for (int i = 0; i < n; i++)
+	{
+		width = std::max(width, (int) (tInput->row[i+1] - tInput->row[i]));
+	}
+
+	tEll->iNumRows = n;
+	tEll->iWidth = width;
+	tEll->stSize = (size_t) n * width;
+	double fill = (double) tEll->stSize / std::max<int64_t>(tInput->stNumNonzeros, 1);
+	if (fill > ELL_MAX_FILL)
+	{
+		std::cerr << "ERROR: ELLPACK would store " << tEll->stSize << " entries for " << tInput->stNumNonzeros
+			<< " nonzeros (fill ratio " << fill << ", longest row " << width << "), use -m sell" << std::endl;
+		return false;
+	}
+
+	tEll->val = (double*) numa_alloc_interleaved(sizeof(double) * std::max<size_t>(tEll->stSize, 1));
+	tEll->col = (int*) numa_alloc_interleaved(sizeof(int) * std::max<size_t>(tEll->stSize, 1));
+	if (tEll->val == NULL || tEll->col == NULL)
+	{
+		std::cerr << "ERROR: could not allocate the " << tEll->stSize << " entries of ELLPACK" << std::endl;
+		if (tEll->val != NULL)
+		{
+			numa_free(tEll->val, sizeof(double) * std::max<size_t>(tEll->stSize, 1));
+		}
+		if (tEll->col != NULL)
+		{
+			numa_free(tEll->col, sizeof(int) * std::max<size_t>(tEll->stSize, 1));
+		}
+		return false;
+	}
+
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n; i++)
+	{
+		int64_t rowbeg = tInput->row[i];
+		int len = (int) (tInput->row[i+1] - rowbeg);
+		int pad = paddingColumn(tInput, i);
+		for (int k = 0; k < width; k++)
+		{
+			size_t idx = (size_t) k * n + i;
+			tEll->val[idx] = (k < len) ? tInput->val[rowbeg + k] : 0.0;
+			tEll->col[idx] = (k < len) ? tInput->col[rowbeg + k] : pad;
+		}
+	}
+
+	std::cout << "ELLPACK: width " << width << ", fill ratio " << fill << std::endl;
+	return true;
+}
+
+void spmxvEllpack(ooo_ellpack *tEll, const double *x, double *y)
+{
+	const int n = tEll->iNumRows;
+	const int width = tEll->iWidth;
+	const double * __restrict__ val = tEll->val;
+	const int    * __restrict__ col = tEll->col;
+
+	// vectorized across rows, every lane walks its own row
+	#pragma omp parallel for simd schedule(simd:static) proc_bind(spread)
+	for (int i = 0; i < n; i++)
+	{
+		double sum = 0.0;
+		for (int k = 0; k < width; k++)
+		{
+			size_t idx = (size_t) k * n + i;
+			sum += val[idx] * x[col[idx]];
+		}
+		y[i] = sum;
+	}
+}
+
+void freeEllpack(ooo_ellpack *tEll)
+{
+	numa_free(tEll->val, sizeof(double) * std::max<size_t>(tEll->stSize, 1));
+	numa_free(tEll->col, sizeof(int) * std::max<size_t>(tEll->stSize, 1));
+}
+
+bool convertToSell(ooo_input *tInput, int iChunkSize, int iSigma, ooo_sell *tSell)
+{
+	int n = tInput->stNumRows;
+	int C = iChunkSize;
+	int numChunks = (n + C - 1) / C;
+	int numPadded = numChunks * C;
+
+	tSell->iNumRows = n;
+	tSell->iChunkSize = C;
+	tSell->iSigma = iSigma;
+	tSell->iNumChunks = numChunks;
+	tSell->perm = new (std::nothrow) int[numPadded];
+	tSell->chunkLen = new (std::nothrow) int[numChunks];
+	tSell->chunkPtr = new (std::nothrow) int64_t[numChunks + 1];
+	if (tSell->perm == NULL || tSell->chunkLen == NULL || tSell->chunkPtr == NULL)
+	{
+		std::cerr << "ERROR: could not allocate the chunk layout of SELL" << std::endl;
+		delete[] tSell->perm;
+		delete[] tSell->chunkLen;
+		delete[] tSell->chunkPtr;
+		return false;
+	}
+
+	// sort rows by descending length within each sigma window
+	int numWindows = (n + iSigma - 1) / iSigma;
+	#pragma omp parallel for schedule(dynamic)
+	for (int w = 0; w < numWindows; w++)
+	{
+		int beg = w * iSigma;
+		int end = std::min(beg + iSigma, n);
+		for (int r = beg; r < end; r++)
+		{
+			tSell->perm[r] = r;
+		}
+		std::stable_sort(tSell->perm + beg, tSell->perm + end, [tInput](int a, int b) {
+			return (tInput->row[a+1] - tInput->row[a]) > (tInput->row[b+1] - tInput->row[b]);
+		});
+	}
+	for (int r = n; r < numPadded; r++)
+	{
+		tSell->perm[r] = -1;
+	}
+
+	#pragma omp parallel for schedule(static)
+	for (int c = 0; c < numChunks; c++)
+	{
+		int len = 0;
+		for (int r = c * C; r < (c + 1) * C; r++)
+		{
+			int i = tSell->perm[r];
+			if (i >= 0)
+			{
+				len = std::max(len, (int) (tInput->row[i+1] - tInput->row[i]));
+			}
+		}
+		tSell->chunkLen[c] = len;
+	}
+
+	tSell->chunkPtr[0] = 0;
+	for (int c = 0; c < numChunks; c++)
+	{
+		tSell->chunkPtr[c+1] = tSell->chunkPtr[c] + (int64_t) tSell->chunkLen[c] * C;
+	}
+
+	tSell->stSize = tSell->chunkPtr[numChunks];
+	tSell->val = (double*) numa_alloc_interleaved(sizeof(double) * std::max<size_t>(tSell->stSize, 1));
+	tSell->col = (int*) numa_alloc_interleaved(sizeof(int) * std::max<size_t>(tSell->stSize, 1));
+	if (tSell->val == NULL || tSell->col == NULL)
+	{
+		std::cerr << "ERROR: could not allocate the " << tSell->stSize << " entries of SELL" << std::endl;
+		if (tSell->val != NULL)
+		{
+			numa_free(tSell->val, sizeof(double) * std::max<size_t>(tSell->stSize, 1));
+		}
+		if (tSell->col != NULL)
+		{
+			numa_free(tSell->col, sizeof(int) * std::max<size_t>(tSell->stSize, 1));
+		}
+		delete[] tSell->perm;
+		delete[] tSell->chunkLen;
+		delete[] tSell->chunkPtr;
+		return false;
+	}
+
+	#pragma omp parallel for schedule(static)
+	for (int c = 0; c < numChunks; c++)
+	{
+		for (int r = 0; r < C; r++)
+		{
+			int i = tSell->perm[c * C + r];
+			int64_t rowbeg = (i >= 0) ? tInput->row[i] : 0;
+			int len = (i >= 0) ? (int) (tInput->row[i+1] - rowbeg) : 0;
+			int pad = (i >= 0) ? paddingColumn(tInput, i) : 0;
+			for (int k = 0; k < tSell->chunkLen[c]; k++)
+			{
+				int64_t idx = tSell->chunkPtr[c] + k * C + r;
+				tSell->val[idx] = (k < len) ? tInput->val[rowbeg + k] : 0.0;
+				tSell->col[idx] = (k < len) ? tInput->col[rowbeg + k] : pad;
+			}
+		}
+	}
+
+	std::cout << "SELL-" << C << "-" << iSigma << ": " << numChunks << " chunks, fill ratio "
+		<< (double) tSell->stSize / tInput->stNumNonzeros << std::endl;
+	return true;
+}
+
+template<int C>
+static void spmxvSellKernel(ooo_sell *tSell, const double *x, double *y)
+{
+	const int n = tSell->iNumRows;
+	const int * __restrict__ perm = tSell->perm;
+
+	#pragma omp parallel for schedule(static) proc_bind(spread)
+	for (int c = 0; c < tSell->iNumChunks; c++)
+	{
+		const double * __restrict__ val = tSell->val + tSell->chunkPtr[c];
+		const int    * __restrict__ col = tSell->col + tSell->chunkPtr[c];
+		double sum[C] = {};
+
+		for (int k = 0; k < tSell->chunkLen[c]; k++)
+		{
+			#pragma omp simd
+			for (int r = 0; r < C; r++)
+			{
+				sum[r] += val[k * C + r] * x[col[k * C + r]];
+			}
+		}
+
+		for (int r = 0; r < C; r++)
+		{
+			if (c * C + r < n)
+			{
+				y[perm[c * C + r]] = sum[r];
+			}
+		}
+	}
+}
+
+void spmxvSell(ooo_sell *tSell, const double *x, double *y)
+{
+	// chunk size is validated by parseCmdLine
+	switch (tSell->iChunkSize)
+	{
+	case 4:  spmxvSellKernel<4>(tSell, x, y);  break;
+	case 8:  spmxvSellKernel<8>(tSell, x, y);  break;
+	case 16: spmxvSellKernel<16>(tSell, x, y); break;
+	case 32: spmxvSellKernel<32>(tSell, x, y); break;
+	}
+}
+
+void freeSell(ooo_sell *tSell)
+{
+	numa_free(tSell->val, sizeof(double) * std::max<size_t>(tSell->stSize, 1));
+	numa_free(tSell->col, sizeof(int) * std::max<size_t>(tSell->stSize, 1));
+	delete[] tSell->perm;
+	delete[] tSell->chunkLen;
+	delete[] tSell->chunkPtr;
+}
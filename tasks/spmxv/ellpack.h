@@ -0,0 +1,59 @@
+#ifndef INC_ELLPACK_H
+#define INC_ELLPACK_H
+
+#include <stddef.h>
+
+#include "ooo_cmdline.h"
+
+// ELLPACK is refused if the padding grows the matrix by more than this factor
+#define ELL_MAX_FILL 8.0
+
+/**
+ * ELLPACK storage: every row is padded to the length of the longest row,
+ * values and columns are stored column-major (entry k of row i at k*iNumRows+i)
+ * so that consecutive rows are contiguous and the kernel vectorizes over rows.
+ */
+struct ooo_ellpack
+{
+	int				iNumRows;
+	int				iWidth;			// nonzeros of the longest row
+	double			*val;
+	int				*col;
+	size_t			stSize;			// number of stored (padded) entries
+};
+
+/**
+ * SELL-C-sigma storage: rows are sorted by length (descending) within windows
+ * of sigma rows and grouped into chunks of C rows. Each chunk is an ELLPACK
+ * block padded only to its own longest row.
+ */
+struct ooo_sell
+{
+	int				iNumRows;
+	int				iChunkSize;		// C
+	int				iSigma;			// sorting window
+	int				iNumChunks;
+	int64_t			*chunkPtr;		// offset of chunk c in val/col
+	int				*chunkLen;		// width of chunk c
+	int				*perm;			// perm[r]: original row stored at sorted position r
+	double			*val;
+	int				*col;
+	size_t			stSize;			// number of stored (padded) entries
+};
+
+/**
+ * @return false if the longest row pads the matrix beyond ELL_MAX_FILL or the
+ * padded arrays cannot be allocated
+ */
+bool convertToEllpack(ooo_input *tInput, ooo_ellpack *tEll);
+void spmxvEllpack(ooo_ellpack *tEll, const double *x, double *y);
+void freeEllpack(ooo_ellpack *tEll);
+
+/**
+ * @return false if the chunks or their padded arrays cannot be allocated
+ */
+bool convertToSell(ooo_input *tInput, int iChunkSize, int iSigma, ooo_sell *tSell);
+void spmxvSell(ooo_sell *tSell, const double *x, double *y);
+void freeSell(ooo_sell *tSell);
+
+#endif
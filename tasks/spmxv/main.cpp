@@ -4,102 +4,445 @@
 #include <omp.h>
 #include <numa.h>
 
+// C++ header
+#include <new>
+#include <iostream>
+
 #include "ooo_cmdline.h"
+#include "ellpack.h"
+#include "csr.h"
+#include "compressed.h"
+#include "symmetric.h"
+#include "reorder.h"
+#include "panel.h"
+#include "bcsr.h"
+#include "persistent.h"
+#include "solver.h"
+#include "precond.h"
+#include "roofline.h"
+#include "domain.h"
+#include "distributed.h"
+#include "tuner.h"
+#include "transpose.h"
+#include "ooo_verify.h"
+
+// releases the storage format spmxv built for iFormat
+static void freeFormat(int iFormat, ooo_ellpack *tEll, ooo_sell *tSell, ooo_csr_rl *tRl, ooo_merge_path *tMp,
+    ooo_cmp_csr *tCmp, ooo_sym *tSym, ooo_panel_csr *tPanel, ooo_bcsr *tBcsr)
+{
+    switch (iFormat)
+    {
+    case MFORMAT_ELLPACK:
+        freeEllpack(tEll);
+        break;
+    case MFORMAT_SELL:
+        freeSell(tSell);
+        break;
+    case MFORMAT_CSR_RL:
+        freeCsrRowLength(tRl);
+        break;
+    case MFORMAT_CSR_MERGE:
+        freeMergePath(tMp);
+        break;
+    case MFORMAT_CSR_CMP:
+        freeCompressed(tCmp);
+        break;
+    case MFORMAT_CSR_SYM:
+        freeSymmetric(tSym);
+        break;
+    case MFORMAT_CSR_PANEL:
+        freePanels(tPanel);
+        break;
+    case MFORMAT_BCSR:
+        freeBcsr(tBcsr);
+        break;
+    }
+}
+
+// entry i of lane v of x: the loaded vector or ones, scaled by v + 1 so that no two lanes are equal
+static inline double xEntry(const double *xIn, int i, int v)
+{
+    return ((xIn != NULL) ? xIn[i] : 1.0) * (v + 1);
+}
 
-void spmxv(ooo_options *tOptions, ooo_input *tInput)
+bool spmxv(ooo_options *tOptions, ooo_input *tInput)
 {
     int iNumRepetitions = tOptions->iNumRepetitions; // set with -r <numrep>
+    int nv = tOptions->iNumVectors; // set with -b <nvec>, x and y are row-major n x nv
 
-    size_t y_size = sizeof(double) * (tInput->stNumRows);
-    size_t Aval_size = sizeof(double) * (tInput->stNumNonzeros);
-    size_t Acol_size = sizeof(int) * (tInput->stNumNonzeros);
-    size_t Arow_size = sizeof(int) * (tInput->stNumRows + 1);
-    size_t x_size = sizeof(double) * (tInput->stNumRows);
-    size_t timings_size = sizeof(timespan) * iNumRepetitions;
+    size_t x_size = sizeof(double) * (tInput->stNumRows) * nv;
 
-    double * __restrict__ y = (double*) numa_alloc_interleaved(y_size);
-    double * __restrict__ Aval = (double*) numa_alloc_interleaved(Aval_size);
-    int    * __restrict__ Acol = (int*) numa_alloc_interleaved(Acol_size);
-    int    * __restrict__ Arow = (int*) numa_alloc_interleaved(Arow_size);
-    double * __restrict__ x = (double*) numa_alloc_interleaved(x_size);
+    // matrix and y are placed by first touch per partition block, x is read by all threads,
+    // all of them are released by tDevice on return
+    ooo_memory tDevice;
+    double  * __restrict__ y = tDevice.allocateNuma<double>((size_t) tInput->stNumRows * nv);
+    double  * __restrict__ Aval = tDevice.allocateNuma<double>(tInput->stNumNonzeros);
+    int     * __restrict__ Acol = tDevice.allocateNuma<int>(tInput->stNumNonzeros);
+    int64_t * __restrict__ Arow = tDevice.allocateNuma<int64_t>(tInput->stNumRows + 1);
+    double  * __restrict__ x = tDevice.allocateInterleaved<double>((size_t) tInput->stNumRows * nv);
 
     // allocate helper data
-    timespan *timings = (timespan*) malloc(sizeof(timespan) * iNumRepetitions);
+    timespan *timings = tDevice.allocate<timespan>(iNumRepetitions);
     double t1, t2;
 
-    int i, rep;
-    #pragma omp parallel
+    // bandwidth-reducing reordering, applied to the loaded matrix once,
+    // the result is checked against a copy of the matrix as loaded
+    ooo_input tOriginal;
+    if (tOptions->reorder != REORDER_NONE && tOptions->verify)
+    {
+        copyInput(tInput, &tOriginal);
+    }
+    ooo_reorder tReorder;
+    bool bReordered = tOptions->reorder != REORDER_NONE && reorderMatrix(tInput, tOptions->reorder, &tReorder);
+
+    // -m auto: format and thread count of the (reordered) matrix, from trials or the cache
+    if (tOptions->mformat == MFORMAT_AUTO)
+    {
+        tuneFormat(tOptions, tInput);
+    }
+
+    // nonzero-balanced static row partition, reused by every repetition
+    ooo_partition tPart;
+    partitionRows(tInput->row, tInput->stNumRows, omp_get_max_threads(), &tPart);
+
+    // convert to the requested storage format outside of the time measurement
+    ooo_ellpack tEll;
+    ooo_sell tSell;
+    ooo_csr_rl tRl;
+    ooo_merge_path tMp;
+    ooo_cmp_csr tCmp;
+    ooo_sym tSym;
+    ooo_panel_csr tPanel;
+    ooo_bcsr tBcsr;
+    if (tOptions->mformat == MFORMAT_ELLPACK)
+    {
+        if (! convertToEllpack(tInput, &tEll))
+        {
+            freePartition(&tPart);
+            if (bReordered)
+            {
+                freeReorder(&tReorder);
+            }
+            return false;
+        }
+    }
+    else if (tOptions->mformat == MFORMAT_SELL)
+    {
+        if (! convertToSell(tInput, tOptions->sellC, tOptions->sellSigma, &tSell))
+        {
+            freePartition(&tPart);
+            if (bReordered)
+            {
+                freeReorder(&tReorder);
+            }
+            return false;
+        }
+    }
+    else if (tOptions->mformat == MFORMAT_CSR_RL)
+    {
+        classifyRows(tInput, &tPart, &tRl);
+    }
+    else if (tOptions->mformat == MFORMAT_CSR_MERGE)
+    {
+        mergePathPartition(tInput->row, tInput->stNumRows, tPart.iNumParts, &tMp);
+    }
+    else if (tOptions->mformat == MFORMAT_CSR_CMP)
+    {
+        convertToCompressed(tInput, &tPart, tOptions->valuePrecision, &tCmp);
+    }
+    else if (tOptions->mformat == MFORMAT_CSR_SYM)
+    {
+        convertToSymmetric(tInput, tPart.iNumParts, &tSym);
+    }
+    else if (tOptions->mformat == MFORMAT_CSR_PANEL)
+    {
+        int panelCols = tOptions->panelCols > 0 ? tOptions->panelCols : defaultPanelCols();
+        convertToPanels(tInput, &tPart, panelCols, &tPanel);
+    }
+    else if (tOptions->mformat == MFORMAT_BCSR)
+    {
+        convertToBcsr(tInput, tOptions->bcsrRows, tOptions->bcsrCols, tPart.iNumParts, &tBcsr);
+    }
+
+    // y = A^T x from per-thread buffers or a transposed copy
+    ooo_transpose tTrans;
+    if (tOptions->transpose != TRANSPOSE_NONE && ! setupTranspose(tOptions, tInput, &tPart, &tTrans))
     {
-        #pragma omp for schedule(static)
-        for (i = 0; i < tInput->stNumRows; i++)
+        freeFormat(tOptions->mformat, &tEll, &tSell, &tRl, &tMp, &tCmp, &tSym, &tPanel, &tBcsr);
+        freePartition(&tPart);
+        if (bReordered)
         {
-            Arow[i] = tInput->row[i];
-            y[i] = 0.0;
-            x[i] = 1;
+            freeReorder(&tReorder);
         }
+        return false;
+    }
 
-        #pragma omp single
-        Arow[tInput->stNumRows] = tInput->stNumNonzeros;
+    // modelled traffic of one repetition in the stored format, for the roofline report
+    ooo_roofline tRoofline;
+    estimateVectorTraffic(tInput, &tPart, nv, &tRoofline);
+    double csrBytes = (double) tInput->stNumNonzeros * (sizeof(double) + sizeof(int)) + sizeof(int64_t) * (tInput->stNumRows + 1.0);
+    switch (tOptions->mformat)
+    {
+    case MFORMAT_ELLPACK:
+        tRoofline.dMatrixBytes = (double) tEll.stSize * (sizeof(double) + sizeof(int));
+        break;
+    case MFORMAT_SELL:
+        tRoofline.dMatrixBytes = (double) tSell.stSize * (sizeof(double) + sizeof(int))
+            + (sizeof(int64_t) + sizeof(int)) * (double) tSell.iNumChunks + sizeof(int) * (double) tSell.iNumRows;
+        break;
+    case MFORMAT_CSR_CMP:
+        tRoofline.dMatrixBytes = sizeof(uint16_t) * (double) tCmp.stNum16 + sizeof(int) * (double) tCmp.stNum32
+            + sizeof(float) * (double) tCmp.stNumF + sizeof(double) * (double) tCmp.stNumD + sizeof(int64_t) * (tInput->stNumRows + 1.0);
+        break;
+    case MFORMAT_CSR_SYM:
+        // the transposed contributions are written to and summed from the thread buffers
+        tRoofline.dMatrixBytes = (double) tSym.stNumStored * (sizeof(double) + sizeof(int))
+            + sizeof(int64_t) * (tSym.iNumRows + 1.0) + sizeof(double) * (double) tSym.iNumRows;
+        tRoofline.dYBytes += 2.0 * sizeof(double) * tSym.stBufSize;
+        break;
+    case MFORMAT_CSR_PANEL:
+        // every nonempty row of a panel updates y once
+        tRoofline.dMatrixBytes = (double) tPanel.stNumNonzeros * (sizeof(double) + sizeof(int))
+            + (sizeof(int64_t) + sizeof(int)) * (double) tPanel.stNumRowEntries;
+        tRoofline.dYBytes += 2.0 * sizeof(double) * tPanel.stNumRowEntries;
+        break;
+    case MFORMAT_BCSR:
+        tRoofline.dMatrixBytes = (double) tBcsr.stNumBlocks * (sizeof(double) * tBcsr.iBlockRows * tBcsr.iBlockCols + sizeof(int))
+            + sizeof(int64_t) * (tBcsr.iNumBlockRows + 1.0);
+        break;
+    default:
+        tRoofline.dMatrixBytes = csrBytes;
+        break;
+    }
+    if (tOptions->transpose == TRANSPOSE_CSC)
+    {
+        estimateVectorTraffic(&tTrans.tCsc, &tTrans.tCscPart, nv, &tRoofline);
+    }
+    else if (tOptions->transpose == TRANSPOSE_BUFFERS)
+    {
+        // x is read in row order, the scattered updates go to the thread buffers
+        tRoofline.dXBytes = sizeof(double) * (double) tInput->stNumRows;
+        tRoofline.dYBytes = sizeof(double) * (double) tInput->stNumRows + 2.0 * sizeof(double) * tTrans.stBufSize;
+    }
+    tRoofline.dStreamBandwidth = tOptions->stream ? streamTriad(tPart.iNumParts) : 0.0;
 
-        #pragma omp for schedule(static)
-        for (i = 0; i < tInput->stNumRows; i++)
+    int rep;
+    #pragma omp parallel num_threads(tPart.iNumParts) proc_bind(spread)
+    {
+        // first touch with the same thread placement and rows as the kernel
+        for (int t = omp_get_thread_num(); t < tPart.iNumParts; t += omp_get_num_threads())
         {
-            int rowbeg = Arow[i];
-            int rowend = Arow[i+1];
-            int nz;
-            for (nz = rowbeg; nz < rowend; nz++)
+            for (int i = tPart.rowPtr[t]; i < tPart.rowPtr[t+1]; i++)
             {
-                Aval[nz] = tInput->val[nz];
-                Acol[nz] = tInput->col[nz];
+                Arow[i] = tInput->row[i];
+                for (int v = 0; v < nv; v++)
+                {
+                    y[(size_t) i * nv + v] = 0.0;
+                    x[(size_t) i * nv + v] = xEntry(tInput->x, i, v); // permuted along with the matrix
+                }
+
+                int64_t rowbeg = tInput->row[i];
+                int64_t rowend = tInput->row[i+1];
+                for (int64_t nz = rowbeg; nz < rowend; nz++)
+                {
+                    Aval[nz] = tInput->val[nz];
+                    Acol[nz] = tInput->col[nz];
+                }
             }
         }
+
+        #pragma omp single
+        Arow[tInput->stNumRows] = tInput->stNumNonzeros;
+    }
+
+    // node-local copies of x for the gathers
+    ooo_replicas tRep;
+    bool bReplicated = tOptions->replicateX && replicateVector(x, x_size, &tRep);
+    bool bSetup = ! tOptions->replicateX || bReplicated;
+
+    // node-local slices, built from the first touched x
+    ooo_domain_csr tDom;
+    bool bDomains = bSetup && tOptions->numaDomains && convertToDomains(tInput, &tPart, x, &tDom);
+    bSetup = bSetup && (! tOptions->numaDomains || bDomains);
+
+    // preconditioner on the first touched CSR copy, its applies are timed separately
+    ooo_precond tPrecond;
+    timespan *precondTimings = NULL;
+    bSetup = bSetup && (tOptions->precond == PRECOND_NONE ||
+        setupPrecond(tOptions->precond, &tPart, tInput->stNumRows, Arow, Acol, Aval, &tPrecond));
+    if (! bSetup)
+    {
+        // what was built up to the failed step
+        if (bReplicated)
+        {
+            freeReplicas(&tRep);
+        }
+        if (bDomains)
+        {
+            freeDomains(&tDom);
+        }
+        if (tOptions->transpose != TRANSPOSE_NONE)
+        {
+            freeTranspose(&tTrans);
+        }
+        freeFormat(tOptions->mformat, &tEll, &tSell, &tRl, &tMp, &tCmp, &tSym, &tPanel, &tBcsr);
+        freePartition(&tPart);
+        if (bReordered)
+        {
+            freeReorder(&tReorder);
+        }
+        return false;
+    }
+    if (tOptions->precond != PRECOND_NONE)
+    {
+        precondTimings = tDevice.allocate<timespan>(iNumRepetitions);
     }
 
     // take the time: start
     t1 = omp_get_wtime();
 
-    for (rep = 0; rep < iNumRepetitions; rep++)
+    if (tOptions->persistent)
     {
-        timings[rep].dBegin = omp_get_wtime();
-
-        #pragma omp teams distribute parallel for schedule(dynamic, 1) proc_bind(spread)
-        for (i = 0; i < tInput->stNumRows; i++)
+        spmxvCsrPersistent(&tPart, Arow, Acol, Aval, x, bReplicated ? &tRep : NULL, y, iNumRepetitions, timings);
+    }
+    else
+    {
+        for (rep = 0; rep < iNumRepetitions; rep++)
         {
-            double sum = 0.0;
+            timings[rep].dBegin = omp_get_wtime();
 
-            #pragma omp simd reduction(+:sum)
-            for (int j = Arow[i]; j < Arow[i+1]; j++)
+            switch (tOptions->mformat)
             {
-                sum += Aval[j] * x[Acol[j]];
+            case MFORMAT_ELLPACK:
+                spmxvEllpack(&tEll, x, y);
+                break;
+            case MFORMAT_SELL:
+                spmxvSell(&tSell, x, y);
+                break;
+            case MFORMAT_CSR_RL:
+                spmxvCsrRowLength(&tRl, &tPart, Arow, Acol, Aval, x, y);
+                break;
+            case MFORMAT_CSR_MERGE:
+                spmxvCsrMerge(&tMp, Arow, Acol, Aval, x, y);
+                break;
+            case MFORMAT_CSR_CMP:
+                spmxvCompressed(&tCmp, &tPart, Arow, x, y);
+                break;
+            case MFORMAT_CSR_SYM:
+                spmxvSymmetric(&tSym, x, y);
+                break;
+            case MFORMAT_CSR_PANEL:
+                spmxvPanels(&tPanel, &tPart, x, y);
+                break;
+            case MFORMAT_BCSR:
+                spmxvBcsr(&tBcsr, x, y);
+                break;
+            default:
+                if (tOptions->transpose != TRANSPOSE_NONE)
+                {
+                    spmxvTranspose(&tTrans, Arow, Acol, Aval, x, y);
+                }
+                else if (tOptions->numaDomains)
+                {
+                    spmxvDomains(&tDom);
+                }
+                else if (bReplicated)
+                {
+                    spmmCsrReplicated(&tPart, Arow, Acol, Aval, nv, &tRep, y);
+                }
+                else if (nv > 1)
+                {
+                    spmmCsr(&tPart, Arow, Acol, Aval, nv, x, y);
+                }
+                else
+                {
+                    spmxvCsr(&tPart, Arow, Acol, Aval, x, y);
+                }
+                break;
             }
 
-            y[i] = sum;
+            timings[rep].dEnd = omp_get_wtime();
         }
-
-        timings[rep].dEnd = omp_get_wtime();
     }
 
     // take the time: end
     t2 = omp_get_wtime();
 
-    // error check
-    print_error_check(y, tInput);
+    if (tOptions->numaDomains)
+    {
+        gatherDomains(&tDom, y);
+    }
+
+    if (precondTimings != NULL)
+    {
+        // z = M^-1 y, the SpMV result merely serves as input vector
+        double *z = tDevice.allocate<double>(tInput->stNumRows);
+        for (rep = 0; rep < iNumRepetitions; rep++)
+        {
+            precondTimings[rep].dBegin = omp_get_wtime();
+            applyPrecondTeam(&tPrecond, y, z);
+            precondTimings[rep].dEnd = omp_get_wtime();
+        }
+    }
+
+    // element-wise check against a reference on the input matrix, a reordered y is
+    // mapped back to the loaded row order so that a wrong permutation cannot pass
+    ooo_input *tCheck = tInput;
+    ooo_transpose *tCheckTrans = &tTrans;
+    const double *xCheck = x;
+    const double *yCheck = y;
+    if (bReordered && tOptions->verify)
+    {
+        double *xOriginal = tDevice.allocate<double>((size_t) tInput->stNumRows * nv);
+        double *yOriginal = tDevice.allocate<double>((size_t) tInput->stNumRows * nv);
+        #pragma omp parallel for
+        for (int i = 0; i < tInput->stNumRows; i++)
+        {
+            for (int v = 0; v < nv; v++)
+            {
+                xOriginal[(size_t) i * nv + v] = xEntry(tOriginal.x, i, v);
+            }
+        }
+        unpermuteVector(&tReorder, nv, y, yOriginal);
+        tCheck = &tOriginal;
+        tCheckTrans = NULL;
+        xCheck = xOriginal;
+        yCheck = yOriginal;
+    }
+    bool bCorrect = ! tOptions->verify ||
+        (tOptions->transpose != TRANSPOSE_NONE ? verifyTranspose(tOptions, tCheck, tCheckTrans, xCheck, yCheck) : verifyResult(tOptions, tCheck, xCheck, yCheck));
 
     // process_results
-    print_performance_results(tOptions, t1, t2, timings, tInput);
+    print_performance_results(tOptions, t1, t2, timings, tInput, precondTimings, &tRoofline);
 
-    // cleanup
-    numa_free(y, y_size);
-    numa_free(Aval, Aval_size);
-    numa_free(Acol, Acol_size);
-    numa_free(Arow, Arow_size);
-    numa_free(x, x_size);
-    numa_free(timings, timings_size);
-    free(timings);
+    // cleanup, the arrays of tDevice are released on return
+    if (bReplicated)
+    {
+        freeReplicas(&tRep);
+    }
+    if (tOptions->numaDomains)
+    {
+        freeDomains(&tDom);
+    }
+    if (tOptions->transpose != TRANSPOSE_NONE)
+    {
+        freeTranspose(&tTrans);
+    }
+    freeFormat(tOptions->mformat, &tEll, &tSell, &tRl, &tMp, &tCmp, &tSym, &tPanel, &tBcsr);
+    freePartition(&tPart);
+    if (bReordered)
+    {
+        freeReorder(&tReorder);
+    }
+    if (precondTimings != NULL)
+    {
+        freePrecond(&tPrecond);
+    }
 
+    return bCorrect;
 } // end loop
 
-int main(int argc, char* argv[])
+int benchmark(int argc, char* argv[])
 {
     // parse command line
     ooo_options tOptions;
@@ -108,15 +451,66 @@ int main(int argc, char* argv[])
         return EXIT_FAILURE;
     }
 
-    // load filename
+    // without MPI this process only starts and waits for the ranks
+    if (tOptions.iNumRanks > 1 && isLauncher())
+    {
+        return launchRanks(&tOptions);
+    }
+
+    // load filename or generate the matrix
     ooo_input tInput;
-    if (! loadInputFile_4SMXV(&tOptions, &tInput))
+    if (tOptions.createMat ? ! createMatrix(&tOptions, &tInput) : ! loadInputFile_4SMXV(&tOptions, &tInput))
     {
         return EXIT_FAILURE;
     }
 
+    // input vector, NULL stands for all ones
+    tInput.x = NULL;
+    if (tOptions.xVector == XVECTOR_RANDOM)
+    {
+        randomRHS(&tInput);
+    }
+    else if (tOptions.xVector == XVECTOR_FILE && ! loadVector(&tOptions, &tInput))
+    {
+        return EXIT_FAILURE;
+    }
+    if (tOptions.mformat == MFORMAT_CSR_SYM && ! isSymmetric(&tInput))
+    {
+        std::cerr << "ERROR: matrix is not symmetric, cannot use -m csr-sym" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // row block of this rank, with halo exchange
+    if (tOptions.iNumRanks > 1 || launchedRanks() > 1)
+    {
+        return distributedBenchmark(&tOptions, &tInput) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // iterative solver built on the CSR kernel
+    if (tOptions.solver != SOLVER_NONE)
+    {
+        return solverBenchmark(&tOptions, &tInput) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     // SpMXV-Kernel
-    spmxv(&tOptions, &tInput);
+    return spmxv(&tOptions, &tInput) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
 
-    return EXIT_SUCCESS;
+int main(int argc, char* argv[])
+{
+    // joins the distributed run this process belongs to, if any
+    initRanks(&argc, &argv);
+    int status;
+    try
+    {
+        status = benchmark(argc, argv);
+    }
+    catch (std::bad_alloc &)
+    {
+        // from the arrays of ooo_memory or any other allocation outside a parallel region
+        std::cerr << "ERROR: not enough memory for the matrix and vectors" << std::endl;
+        status = EXIT_FAILURE;
+    }
+    finalizeRanks();
+    return status;
 }
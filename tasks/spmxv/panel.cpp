@@ -0,0 +1,155 @@
+#include "panel.h"
+
+#include <omp.h>
+#include <numa.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+int defaultPanelCols()
+{
+	// half of L2 for x, the rest for the streamed matrix and y
+	long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	if (l2 <= 0)
+	{
+		return PANEL_DEFAULT_COLS;
+	}
+	return std::max<long>(l2 / 2 / sizeof(double), 1024);
+}
+
+void convertToPanels(ooo_input *tInput, ooo_partition *tPart, int iPanelCols, ooo_panel_csr *tPanel)
+{
+	int n = tInput->stNumRows;
+	int maxCol = 0;
+	for (int64_t nz = 0; nz < tInput->stNumNonzeros; nz++)
+	{
+		maxCol = std::max(maxCol, tInput->col[nz]);
+	}
+
+	int parts = tPart->iNumParts;
+	int panels = maxCol / iPanelCols + 1;
+	tPanel->iNumPanels = panels;
+	tPanel->iPanelCols = iPanelCols;
+	tPanel->iNumParts = parts;
+
+	// nonempty rows and nonzeros of every (thread, panel) pair
+	std::vector<int64_t> rowCount((size_t) parts * panels + 1, 0);
+	std::vector<int64_t> nzCount((size_t) parts * panels + 1, 0);
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int t = 0; t < parts; t++)
+	{
+		std::vector<int> lastRow(panels, -1);
+		for (int i = tPart->rowPtr[t]; i < tPart->rowPtr[t+1]; i++)
+		{
+			for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1]; nz++)
+			{
+				int p = tInput->col[nz] / iPanelCols;
+				if (lastRow[p] != i)
+				{
+					lastRow[p] = i;
+					rowCount[(size_t) t * panels + p]++;
+				}
+				nzCount[(size_t) t * panels + p]++;
+			}
+		}
+	}
+
+	// pairs are laid out by thread, then by panel
+	tPanel->panelPtr = new int64_t[(size_t) parts * panels + 1];
+	std::vector<int64_t> nzPtr((size_t) parts * panels + 1);
+	tPanel->panelPtr[0] = 0;
+	nzPtr[0] = 0;
+	for (size_t k = 0; k < (size_t) parts * panels; k++)
+	{
+		tPanel->panelPtr[k+1] = tPanel->panelPtr[k] + rowCount[k];
+		nzPtr[k+1] = nzPtr[k] + nzCount[k];
+	}
+	int64_t numEntries = tPanel->panelPtr[(size_t) parts * panels];
+	tPanel->stNumRowEntries = numEntries;
+	tPanel->stNumNonzeros = tInput->stNumNonzeros;
+
+	tPanel->rowIdx = (int*) numa_alloc(sizeof(int) * std::max<int64_t>(numEntries, 1));
+	tPanel->rowNz = (int64_t*) numa_alloc(sizeof(int64_t) * (numEntries + 1));
+	tPanel->col = (int*) numa_alloc(sizeof(int) * std::max<int64_t>(tInput->stNumNonzeros, 1));
+	tPanel->val = (double*) numa_alloc(sizeof(double) * std::max<int64_t>(tInput->stNumNonzeros, 1));
+
+	// fill with the kernel's thread placement (first touch), the nonzeros
+	// of a row within a panel stay contiguous as rows are visited in order
+	#pragma omp parallel num_threads(parts) proc_bind(spread)
+	{
+		for (int t = omp_get_thread_num(); t < parts; t += omp_get_num_threads())
+		{
+			std::vector<int> lastRow(panels, -1);
+			std::vector<int64_t> entry(tPanel->panelPtr + (size_t) t * panels, tPanel->panelPtr + (size_t) (t + 1) * panels);
+			std::vector<int64_t> pos(nzPtr.begin() + (size_t) t * panels, nzPtr.begin() + (size_t) (t + 1) * panels);
+			for (int i = tPart->rowPtr[t]; i < tPart->rowPtr[t+1]; i++)
+			{
+				for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1]; nz++)
+				{
+					int p = tInput->col[nz] / iPanelCols;
+					if (lastRow[p] != i)
+					{
+						lastRow[p] = i;
+						tPanel->rowIdx[entry[p]] = i;
+						tPanel->rowNz[entry[p]] = pos[p];
+						entry[p]++;
+					}
+					tPanel->col[pos[p]] = tInput->col[nz];
+					tPanel->val[pos[p]] = tInput->val[nz];
+					pos[p]++;
+				}
+			}
+		}
+	}
+	tPanel->rowNz[numEntries] = tInput->stNumNonzeros;
+
+	std::cout << "Column panels: " << panels << " panels of " << iPanelCols << " columns, "
+		<< (double) numEntries / std::max(n, 1) << " panel rows per row" << std::endl;
+}
+
+void spmxvPanels(ooo_panel_csr *tPanel, ooo_partition *tPart, const double *x, double *y)
+{
+	const int panels = tPanel->iNumPanels;
+	const int    * __restrict__ rowIdx = tPanel->rowIdx;
+	const int64_t * __restrict__ rowNz = tPanel->rowNz;
+	const int    * __restrict__ col = tPanel->col;
+	const double * __restrict__ val = tPanel->val;
+
+	#pragma omp parallel num_threads(tPart->iNumParts) proc_bind(spread)
+	{
+		for (int t = omp_get_thread_num(); t < tPart->iNumParts; t += omp_get_num_threads())
+		{
+			for (int i = tPart->rowPtr[t]; i < tPart->rowPtr[t+1]; i++)
+			{
+				y[i] = 0.0;
+			}
+
+			// one x segment at a time
+			for (int p = 0; p < panels; p++)
+			{
+				for (int64_t k = tPanel->panelPtr[(size_t) t * panels + p]; k < tPanel->panelPtr[(size_t) t * panels + p + 1]; k++)
+				{
+					// panel rows are short, a plain loop beats the vectorised one
+					double sum = 0.0;
+					for (int64_t j = rowNz[k]; j < rowNz[k+1]; j++)
+					{
+						sum += val[j] * x[col[j]];
+					}
+
+					y[rowIdx[k]] += sum;
+				}
+			}
+		}
+	}
+}
+
+void freePanels(ooo_panel_csr *tPanel)
+{
+	numa_free(tPanel->rowIdx, sizeof(int) * std::max<int64_t>(tPanel->stNumRowEntries, 1));
+	numa_free(tPanel->rowNz, sizeof(int64_t) * (tPanel->stNumRowEntries + 1));
+	numa_free(tPanel->col, sizeof(int) * std::max<int64_t>(tPanel->stNumNonzeros, 1));
+	numa_free(tPanel->val, sizeof(double) * std::max<int64_t>(tPanel->stNumNonzeros, 1));
+	delete[] tPanel->panelPtr;
+}
@@ -0,0 +1,37 @@
+#ifndef INC_PANEL_H
+#define INC_PANEL_H
+
+#include "ooo_cmdline.h"
+#include "csr.h"
+
+// panel width if the L2 size cannot be queried
+#define PANEL_DEFAULT_COLS 32768
+
+/**
+ * Column-panel CSR: the columns are cut into panels of iPanelCols, so the
+ * x segment of a panel stays cache resident while all rows of a thread
+ * sweep over it. Every (thread, panel) pair stores only its nonempty rows:
+ * entry k belongs to row rowIdx[k], its nonzeros are rowNz[k] .. rowNz[k+1]-1,
+ * and the entries of pair (t, p) are panelPtr[t * iNumPanels + p] ..
+ * panelPtr[t * iNumPanels + p + 1]-1.
+ */
+struct ooo_panel_csr
+{
+	int				iNumPanels;
+	int				iPanelCols;
+	int				iNumParts;
+	int64_t			*panelPtr;
+	int				*rowIdx;
+	int64_t			*rowNz;
+	int				*col;
+	double			*val;
+	int64_t			stNumRowEntries;
+	int64_t			stNumNonzeros;
+};
+
+int defaultPanelCols();
+void convertToPanels(ooo_input *tInput, ooo_partition *tPart, int iPanelCols, ooo_panel_csr *tPanel);
+void spmxvPanels(ooo_panel_csr *tPanel, ooo_partition *tPart, const double *x, double *y);
+void freePanels(ooo_panel_csr *tPanel);
+
+#endif
@@ -0,0 +1,106 @@
+#include "persistent.h"
+
+#include <omp.h>
+#include <sched.h>
+#include <immintrin.h>
+
+#include <algorithm>
+#include <iostream>
+
+void initBarrier(ooo_barrier *tBarrier, int iNumThreads)
+{
+	tBarrier->iNumThreads = iNumThreads;
+	tBarrier->count.store(iNumThreads, std::memory_order_relaxed);
+	tBarrier->sense.store(0, std::memory_order_relaxed);
+}
+
+void barrierWait(ooo_barrier *tBarrier, int &localSense)
+{
+	localSense = ! localSense;
+	if (tBarrier->count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		tBarrier->count.store(tBarrier->iNumThreads, std::memory_order_relaxed);
+		tBarrier->sense.store(localSense, std::memory_order_release);
+		return;
+	}
+
+	int spins = 0;
+	while (tBarrier->sense.load(std::memory_order_acquire) != localSense)
+	{
+		_mm_pause();
+		// oversubscribed teams would otherwise spin away the time slice of the last thread
+		if (++spins > BARRIER_SPINS)
+		{
+			sched_yield();
+		}
+	}
+}
+
+void spmxvCsrPersistent(ooo_partition *tPart, const int64_t *Arow, const int *Acol, const double *Aval, const double *x, const ooo_replicas *tRep, double *y, int iNumRepetitions, timespan *timings)
+{
+	ooo_barrier tBarrier;
+	double *threadTime = NULL;
+	int numThreads = 1;
+
+	// one team for all repetitions, a repetition ends at the barrier
+	// that starts the next one
+	#pragma omp parallel num_threads(tPart->iNumParts) proc_bind(spread)
+	{
+		int tid = omp_get_thread_num();
+		int nt = omp_get_num_threads();
+
+		#pragma omp single
+		{
+			numThreads = nt;
+			initBarrier(&tBarrier, nt);
+			threadTime = new double[nt];
+			std::fill(threadTime, threadTime + nt, 0.0);
+		}
+
+		// the team stays the same, so the replica is looked up once
+		const double *xl = (tRep != NULL) ? localReplica(tRep) : x;
+		int localSense = 0;
+		double busy = 0.0;
+		barrierWait(&tBarrier, localSense);
+		if (tid == 0 && iNumRepetitions > 0)
+		{
+			timings[0].dBegin = omp_get_wtime();
+		}
+
+		for (int rep = 0; rep < iNumRepetitions; rep++)
+		{
+			double tb = omp_get_wtime();
+			for (int t = tid; t < tPart->iNumParts; t += nt)
+			{
+				spmxvCsrBlock(tPart, t, Arow, Acol, Aval, xl, y);
+			}
+			busy += omp_get_wtime() - tb;
+
+			barrierWait(&tBarrier, localSense);
+			if (tid == 0)
+			{
+				double now = omp_get_wtime();
+				timings[rep].dEnd = now;
+				if (rep + 1 < iNumRepetitions)
+				{
+					timings[rep+1].dBegin = now;
+				}
+			}
+		}
+		threadTime[tid] = busy;
+	}
+
+	// busy time of every thread, the rest of a repetition is spent waiting
+	double minTime = *std::min_element(threadTime, threadTime + numThreads);
+	double maxTime = *std::max_element(threadTime, threadTime + numThreads);
+	double sumTime = 0.0;
+	for (int t = 0; t < numThreads; t++)
+	{
+		sumTime += threadTime[t];
+	}
+	double meanTime = sumTime / numThreads;
+	std::cout << "Persistent team: " << numThreads << " threads, per-thread kernel time min/mean/max "
+		<< minTime / iNumRepetitions << " / " << meanTime / iNumRepetitions << " / " << maxTime / iNumRepetitions
+		<< ", imbalance max/mean " << (meanTime > 0.0 ? maxTime / meanTime : 1.0) << std::endl;
+	delete[] threadTime;
+}
@@ -0,0 +1,29 @@
+#ifndef INC_PERSISTENT_H
+#define INC_PERSISTENT_H
+
+#include <atomic>
+
+#include "ooo_cmdline.h"
+#include "csr.h"
+
+// busy-wait iterations before a waiting thread starts yielding the core
+#define BARRIER_SPINS 64
+
+/**
+ * Centralised sense-reversing barrier: the last thread to arrive resets
+ * the counter and flips the shared sense, all others spin on it.
+ */
+struct ooo_barrier
+{
+	alignas(64) std::atomic<int>	count;
+	alignas(64) std::atomic<int>	sense;
+	int								iNumThreads;
+};
+
+void initBarrier(ooo_barrier *tBarrier, int iNumThreads);
+void barrierWait(ooo_barrier *tBarrier, int &localSense);
+
+// with tRep set, the threads gather from the x replica of their node instead of x
+void spmxvCsrPersistent(ooo_partition *tPart, const int64_t *Arow, const int *Acol, const double *Aval, const double *x, const ooo_replicas *tRep, double *y, int iNumRepetitions, timespan *timings);
+
+#endif
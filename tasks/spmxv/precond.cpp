@@ -0,0 +1,310 @@
+#include "precond.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// levels with fewer rows are cheaper to run on one thread than to synchronise
+#define PRECOND_MIN_LEVEL_ROWS 64
+
+// levels from the dependencies on earlier (lower) or later (upper) rows
+static void buildLevels(int n, const int64_t *Arow, const int *Acol, bool bLower, ooo_level_schedule *tLevels)
+{
+	std::vector<int> level(n, 0);
+	int numLevels = 0;
+	for (int k = 0; k < n; k++)
+	{
+		int i = bLower ? k : n - 1 - k;
+		int l = 0;
+		for (int64_t nz = Arow[i]; nz < Arow[i+1]; nz++)
+		{
+			int c = Acol[nz];
+			if (bLower ? c < i : c > i)
+			{
+				l = std::max(l, level[c] + 1);
+			}
+		}
+		level[i] = l;
+		numLevels = std::max(numLevels, l + 1);
+	}
+
+	// bucket the rows by level, ascending within a level
+	tLevels->iNumLevels = numLevels;
+	tLevels->levelPtr = new int[numLevels + 1]();
+	tLevels->rows = new int[std::max(n, 1)];
+	for (int i = 0; i < n; i++)
+	{
+		tLevels->levelPtr[level[i] + 1]++;
+	}
+	for (int l = 0; l < numLevels; l++)
+	{
+		tLevels->levelPtr[l+1] += tLevels->levelPtr[l];
+	}
+	std::vector<int> pos(tLevels->levelPtr, tLevels->levelPtr + numLevels);
+	for (int i = 0; i < n; i++)
+	{
+		tLevels->rows[pos[level[i]]++] = i;
+	}
+}
+
+static void freeLevels(ooo_level_schedule *tLevels)
+{
+	delete[] tLevels->levelPtr;
+	delete[] tLevels->rows;
+}
+
+/**
+ * ILU(0) in IKJ order, restricted to the pattern of A. Row i only reads
+ * the finished rows it depends on, so the rows of a lower level are
+ * factorised in parallel.
+ */
+static bool factoriseIlu0(ooo_precond *P)
+{
+	const int64_t *Arow = P->Arow;
+	const int *Acol = P->Acol;
+	const int64_t *diagPos = P->diagPos;
+	double *lu = P->luVal;
+	bool bZeroPivot = false;
+
+	auto factoriseRow = [&](int i) {
+		for (int64_t ik = Arow[i]; ik < diagPos[i]; ik++)
+		{
+			int c = Acol[ik];
+			lu[ik] /= lu[diagPos[c]];
+
+			// row i -= l_ic * (upper part of row c), both rows are sorted
+			int64_t pi = ik + 1;
+			int64_t pc = diagPos[c] + 1;
+			while (pi < Arow[i+1] && pc < Arow[c+1])
+			{
+				if (Acol[pi] == Acol[pc])
+				{
+					lu[pi] -= lu[ik] * lu[pc];
+					pi++;
+					pc++;
+				}
+				else if (Acol[pi] < Acol[pc])
+				{
+					pi++;
+				}
+				else
+				{
+					pc++;
+				}
+			}
+		}
+		return lu[diagPos[i]] == 0.0;
+	};
+
+	for (int l = 0; l < P->tLower.iNumLevels; l++)
+	{
+		int beg = P->tLower.levelPtr[l];
+		int end = P->tLower.levelPtr[l+1];
+		if (end - beg < PRECOND_MIN_LEVEL_ROWS)
+		{
+			for (int k = beg; k < end; k++)
+			{
+				bZeroPivot = factoriseRow(P->tLower.rows[k]) || bZeroPivot;
+			}
+			continue;
+		}
+
+		#pragma omp parallel for schedule(dynamic, 16) reduction(||:bZeroPivot)
+		for (int k = beg; k < end; k++)
+		{
+			bZeroPivot = factoriseRow(P->tLower.rows[k]) || bZeroPivot;
+		}
+	}
+	return ! bZeroPivot;
+}
+
+bool setupPrecond(int iType, ooo_partition *tPart, int iNumRows, const int64_t *Arow, const int *Acol, const double *Aval, ooo_precond *tPrecond)
+{
+	double t1 = omp_get_wtime();
+	int n = iNumRows;
+	tPrecond->iType = iType;
+	tPrecond->iNumRows = n;
+	tPrecond->tPart = tPart;
+	tPrecond->Arow = Arow;
+	tPrecond->Acol = Acol;
+	tPrecond->invDiag = NULL;
+	tPrecond->luVal = NULL;
+	tPrecond->diagPos = NULL;
+
+	// both preconditioners need sorted rows with a diagonal entry
+	std::vector<int64_t> diagPos(n);
+	bool bValid = true;
+	#pragma omp parallel for reduction(&&:bValid)
+	for (int i = 0; i < n; i++)
+	{
+		diagPos[i] = -1;
+		for (int64_t nz = Arow[i]; nz < Arow[i+1]; nz++)
+		{
+			bValid = bValid && (nz == Arow[i] || Acol[nz-1] < Acol[nz]);
+			if (Acol[nz] == i)
+			{
+				diagPos[i] = nz;
+			}
+		}
+		bValid = bValid && diagPos[i] >= 0 && Aval[diagPos[i]] != 0.0;
+	}
+	if (! bValid)
+	{
+		std::cerr << "ERROR: preconditioner needs sorted rows and a nonzero diagonal" << std::endl;
+		return false;
+	}
+
+	if (iType == PRECOND_JACOBI)
+	{
+		tPrecond->invDiag = tPrecond->tMemory.allocateNuma<double>(n);
+		#pragma omp parallel num_threads(tPart->iNumParts) proc_bind(spread)
+		{
+			for (int t = omp_get_thread_num(); t < tPart->iNumParts; t += omp_get_num_threads())
+			{
+				for (int i = tPart->rowPtr[t]; i < tPart->rowPtr[t+1]; i++)
+				{
+					tPrecond->invDiag[i] = 1.0 / Aval[diagPos[i]];
+				}
+			}
+		}
+		std::cout << "Jacobi preconditioner: setup took " << omp_get_wtime() - t1 << " s" << std::endl;
+		return true;
+	}
+
+	int64_t nnz = Arow[n];
+	tPrecond->diagPos = tPrecond->tMemory.allocate<int64_t>(n);
+	std::copy(diagPos.begin(), diagPos.end(), tPrecond->diagPos);
+	tPrecond->luVal = tPrecond->tMemory.allocateNuma<double>(nnz);
+	#pragma omp parallel for
+	for (int64_t nz = 0; nz < nnz; nz++)
+	{
+		tPrecond->luVal[nz] = Aval[nz];
+	}
+
+	buildLevels(n, Arow, Acol, true, &tPrecond->tLower);
+	buildLevels(n, Arow, Acol, false, &tPrecond->tUpper);
+	if (! factoriseIlu0(tPrecond))
+	{
+		std::cerr << "ERROR: zero pivot in the ILU(0) factorisation" << std::endl;
+		freePrecond(tPrecond);
+		return false;
+	}
+
+	std::cout << "ILU(0) preconditioner: " << tPrecond->tLower.iNumLevels << " forward and "
+		<< tPrecond->tUpper.iNumLevels << " backward levels, "
+		<< (double) n / std::max(tPrecond->tLower.iNumLevels, 1) << " rows per level, "
+		<< "setup took " << omp_get_wtime() - t1 << " s" << std::endl;
+	return true;
+}
+
+/**
+ * Runs rowFn for every row of the schedule. The rows of a wide level are
+ * split into contiguous chunks followed by a barrier, runs of narrow
+ * levels are done by thread 0 alone with a single barrier at the end.
+ */
+template<typename RowFn>
+static inline void sweepLevels(const ooo_level_schedule &S, int tid, int nt, ooo_barrier *tBarrier, int &sense, RowFn rowFn)
+{
+	int l = 0;
+	while (l < S.iNumLevels)
+	{
+		int cnt = S.levelPtr[l+1] - S.levelPtr[l];
+		if (cnt >= PRECOND_MIN_LEVEL_ROWS && nt > 1)
+		{
+			int beg = S.levelPtr[l] + (int) ((long) cnt * tid / nt);
+			int end = S.levelPtr[l] + (int) ((long) cnt * (tid + 1) / nt);
+			for (int k = beg; k < end; k++)
+			{
+				rowFn(S.rows[k]);
+			}
+			l++;
+		}
+		else
+		{
+			int first = l;
+			while (l < S.iNumLevels && (nt == 1 || S.levelPtr[l+1] - S.levelPtr[l] < PRECOND_MIN_LEVEL_ROWS))
+			{
+				l++;
+			}
+			if (tid == 0)
+			{
+				for (int k = S.levelPtr[first]; k < S.levelPtr[l]; k++)
+				{
+					rowFn(S.rows[k]);
+				}
+			}
+		}
+		barrierWait(tBarrier, sense);
+	}
+}
+
+/**
+ * z = M^-1 r, called by every thread of the team. Returns after a barrier,
+ * so all of z is complete afterwards.
+ */
+void applyPrecond(ooo_precond *tPrecond, int tid, int nt, ooo_barrier *tBarrier, int &sense, const double *r, double *z)
+{
+	const ooo_partition *tPart = tPrecond->tPart;
+	if (tPrecond->iType == PRECOND_JACOBI)
+	{
+		for (int t = tid; t < tPart->iNumParts; t += nt)
+		{
+			for (int i = tPart->rowPtr[t]; i < tPart->rowPtr[t+1]; i++)
+			{
+				z[i] = tPrecond->invDiag[i] * r[i];
+			}
+		}
+		barrierWait(tBarrier, sense);
+		return;
+	}
+
+	const int64_t *Arow = tPrecond->Arow;
+	const int *Acol = tPrecond->Acol;
+	const double *lu = tPrecond->luVal;
+	const int64_t *diagPos = tPrecond->diagPos;
+
+	// L z = r, level by level
+	sweepLevels(tPrecond->tLower, tid, nt, tBarrier, sense, [&](int i) {
+		double sum = r[i];
+		for (int64_t nz = Arow[i]; nz < diagPos[i]; nz++)
+		{
+			sum -= lu[nz] * z[Acol[nz]];
+		}
+		z[i] = sum;
+	});
+
+	// U z = z in place, every row only reads later rows
+	sweepLevels(tPrecond->tUpper, tid, nt, tBarrier, sense, [&](int i) {
+		double sum = z[i];
+		for (int64_t nz = diagPos[i] + 1; nz < Arow[i+1]; nz++)
+		{
+			sum -= lu[nz] * z[Acol[nz]];
+		}
+		z[i] = sum / lu[diagPos[i]];
+	});
+}
+
+void applyPrecondTeam(ooo_precond *tPrecond, const double *r, double *z)
+{
+	#pragma omp parallel num_threads(tPrecond->tPart->iNumParts) proc_bind(spread)
+	{
+		int sense = 0;
+
+		#pragma omp single
+		initBarrier(&tPrecond->tBarrier, omp_get_num_threads());
+
+		applyPrecond(tPrecond, omp_get_thread_num(), omp_get_num_threads(), &tPrecond->tBarrier, sense, r, z);
+	}
+}
+
+void freePrecond(ooo_precond *tPrecond)
+{
+	if (tPrecond->iType == PRECOND_ILU0)
+	{
+		freeLevels(&tPrecond->tLower);
+		freeLevels(&tPrecond->tUpper);
+	}
+	tPrecond->tMemory.release();
+}
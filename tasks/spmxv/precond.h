@@ -0,0 +1,47 @@
+#ifndef INC_PRECOND_H
+#define INC_PRECOND_H
+
+#include "ooo_cmdline.h"
+#include "csr.h"
+#include "persistent.h"
+
+/**
+ * Dependency levels of a triangular solve: the rows of level l,
+ * rows[levelPtr[l]] .. rows[levelPtr[l+1]-1], only depend on rows of
+ * earlier levels and can be processed in parallel.
+ */
+struct ooo_level_schedule
+{
+	int				iNumLevels;
+	int				*levelPtr;
+	int				*rows;
+};
+
+/**
+ * Jacobi (inverse diagonal) or ILU(0) preconditioner. The ILU(0) factors
+ * share the pattern of A: the strict lower part holds L (unit diagonal),
+ * the rest U, diagPos[i] is the position of a_ii. tMemory owns invDiag,
+ * luVal and diagPos.
+ */
+struct ooo_precond
+{
+	int					iType;
+	int					iNumRows;
+	ooo_partition		*tPart;
+	double				*invDiag;
+	const int64_t		*Arow;
+	const int			*Acol;
+	double				*luVal;
+	int64_t				*diagPos;
+	ooo_level_schedule	tLower;
+	ooo_level_schedule	tUpper;
+	ooo_barrier			tBarrier;	// of applyPrecondTeam
+	ooo_memory			tMemory;
+};
+
+bool setupPrecond(int iType, ooo_partition *tPart, int iNumRows, const int64_t *Arow, const int *Acol, const double *Aval, ooo_precond *tPrecond);
+void applyPrecond(ooo_precond *tPrecond, int tid, int nt, ooo_barrier *tBarrier, int &sense, const double *r, double *z);
+void applyPrecondTeam(ooo_precond *tPrecond, const double *r, double *z);
+void freePrecond(ooo_precond *tPrecond);
+
+#endif
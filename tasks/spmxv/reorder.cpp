@@ -0,0 +1,474 @@
+#include "reorder.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+/**
+ * Adjacency of the symmetrised pattern A + A^T without the diagonal.
+ */
+struct ooo_graph
+{
+	int						iNumVertices;
+	std::vector<int64_t>	adjPtr;
+	std::vector<int>		adj;
+};
+
+static void buildGraph(ooo_input *tInput, ooo_graph &g)
+{
+	int n = tInput->stNumRows;
+	g.iNumVertices = n;
+	g.adjPtr.assign(n + 1, 0);
+
+	for (int i = 0; i < n; i++)
+	{
+		for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1]; nz++)
+		{
+			int c = tInput->col[nz];
+			if (c != i)
+			{
+				g.adjPtr[i+1]++;
+				g.adjPtr[c+1]++;
+			}
+		}
+	}
+	for (int i = 0; i < n; i++)
+	{
+		g.adjPtr[i+1] += g.adjPtr[i];
+	}
+
+	std::vector<int64_t> pos(g.adjPtr.begin(), g.adjPtr.end() - 1);
+	g.adj.resize(g.adjPtr[n]);
+	for (int i = 0; i < n; i++)
+	{
+		for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1]; nz++)
+		{
+			int c = tInput->col[nz];
+			if (c != i)
+			{
+				g.adj[pos[i]++] = c;
+				g.adj[pos[c]++] = i;
+			}
+		}
+	}
+
+	// drop the duplicates of entries present in both triangles
+	int64_t k = 0;
+	for (int i = 0; i < n; i++)
+	{
+		int *beg = &g.adj[0] + g.adjPtr[i];
+		int *end = &g.adj[0] + g.adjPtr[i+1];
+		std::sort(beg, end);
+		int *uend = std::unique(beg, end);
+		g.adjPtr[i] = k;
+		for (int *p = beg; p < uend; p++)
+		{
+			g.adj[k++] = *p;
+		}
+	}
+	g.adjPtr[n] = k;
+	g.adj.resize(k);
+}
+
+static inline int degree(const ooo_graph &g, int v)
+{
+	return (int) (g.adjPtr[v+1] - g.adjPtr[v]);
+}
+
+/**
+ * Breadth-first search from root over the vertices labelled lbl, appends
+ * them to order and returns the number of levels. The start of the last
+ * level in order is returned in lastLevel.
+ */
+static int bfs(const ooo_graph &g, int root, const int *label, int lbl, int *mark, int stamp, bool bSortByDegree, std::vector<int> &order, size_t &lastLevel)
+{
+	size_t head = order.size();
+	size_t levelEnd = head + 1;
+	int numLevels = 1;
+	lastLevel = head;
+
+	order.push_back(root);
+	mark[root] = stamp;
+	while (head < order.size())
+	{
+		if (head == levelEnd)
+		{
+			lastLevel = head;
+			levelEnd = order.size();
+			numLevels++;
+		}
+
+		int v = order[head++];
+		size_t first = order.size();
+		for (int64_t k = g.adjPtr[v]; k < g.adjPtr[v+1]; k++)
+		{
+			int u = g.adj[k];
+			if (label[u] == lbl && mark[u] != stamp)
+			{
+				mark[u] = stamp;
+				order.push_back(u);
+			}
+		}
+
+		// Cuthill-McKee visits the neighbours by increasing degree
+		if (bSortByDegree)
+		{
+			std::sort(order.begin() + first, order.end(), [&g](int a, int b) {
+				return degree(g, a) < degree(g, b);
+			});
+		}
+	}
+	return numLevels;
+}
+
+/**
+ * George-Liu search for a pseudo-peripheral vertex of root's component:
+ * restart from a minimum-degree vertex of the last level as long as the
+ * eccentricity grows.
+ */
+static int peripheralVertex(const ooo_graph &g, int root, const int *label, int lbl, int *mark, int &stamp, std::vector<int> &tmp)
+{
+	size_t lastLevel;
+	tmp.clear();
+	int ecc = bfs(g, root, label, lbl, mark, ++stamp, false, tmp, lastLevel);
+
+	for (int it = 0; it < REORDER_PERIPHERAL_ITER; it++)
+	{
+		int cand = tmp[lastLevel];
+		for (size_t k = lastLevel; k < tmp.size(); k++)
+		{
+			if (degree(g, tmp[k]) < degree(g, cand))
+			{
+				cand = tmp[k];
+			}
+		}
+
+		tmp.clear();
+		int eccCand = bfs(g, cand, label, lbl, mark, ++stamp, false, tmp, lastLevel);
+		if (eccCand <= ecc)
+		{
+			break;
+		}
+		root = cand;
+		ecc = eccCand;
+	}
+	return root;
+}
+
+// Reverse Cuthill-McKee, components in order of their minimum degree
+static void orderRcm(const ooo_graph &g, int *perm)
+{
+	int n = g.iNumVertices;
+	std::vector<int> label(n, 0);
+	std::vector<int> mark(n, 0);
+	std::vector<int> byDegree(n);
+	std::vector<int> order, tmp;
+	int stamp = 0;
+	size_t lastLevel;
+
+	for (int i = 0; i < n; i++)
+	{
+		byDegree[i] = i;
+	}
+	std::stable_sort(byDegree.begin(), byDegree.end(), [&g](int a, int b) {
+		return degree(g, a) < degree(g, b);
+	});
+
+	order.reserve(n);
+	for (int k = 0; k < n; k++)
+	{
+		if (label[byDegree[k]] != 0)
+		{
+			continue;
+		}
+		int root = peripheralVertex(g, byDegree[k], &label[0], 0, &mark[0], stamp, tmp);
+		size_t first = order.size();
+		bfs(g, root, &label[0], 0, &mark[0], ++stamp, true, order, lastLevel);
+		for (size_t j = first; j < order.size(); j++)
+		{
+			label[order[j]] = 1;
+		}
+	}
+
+	for (int i = 0; i < n; i++)
+	{
+		perm[i] = order[n - 1 - i];
+	}
+}
+
+/**
+ * Recursive bisection of verts[b..e) (all labelled lbl) along a
+ * breadth-first order from a pseudo-peripheral vertex, which keeps the
+ * rows of a part, and thus most of the x entries it reads, together.
+ */
+static void bisect(const ooo_graph &g, int *verts, int b, int e, int lbl, int *label, int *mark, int &stamp, int &nextLabel, std::vector<int> &tmp)
+{
+	if (e - b <= REORDER_PART_ROWS)
+	{
+		return;
+	}
+
+	int placed = nextLabel++;
+	std::vector<int> order;
+	size_t lastLevel;
+	order.reserve(e - b);
+	for (int k = b; k < e; k++)
+	{
+		if (label[verts[k]] != lbl)
+		{
+			continue;
+		}
+		int root = peripheralVertex(g, verts[k], label, lbl, mark, stamp, tmp);
+		size_t first = order.size();
+		bfs(g, root, label, lbl, mark, ++stamp, false, order, lastLevel);
+		for (size_t j = first; j < order.size(); j++)
+		{
+			label[order[j]] = placed;
+		}
+	}
+	std::copy(order.begin(), order.end(), verts + b);
+
+	int mid = b + (e - b) / 2;
+	int lo = nextLabel++;
+	int hi = nextLabel++;
+	for (int k = b; k < e; k++)
+	{
+		label[verts[k]] = (k < mid) ? lo : hi;
+	}
+	bisect(g, verts, b, mid, lo, label, mark, stamp, nextLabel, tmp);
+	bisect(g, verts, mid, e, hi, label, mark, stamp, nextLabel, tmp);
+}
+
+static void orderPartition(const ooo_graph &g, int *perm)
+{
+	int n = g.iNumVertices;
+	std::vector<int> label(n, 0);
+	std::vector<int> mark(n, 0);
+	std::vector<int> tmp;
+	int stamp = 0;
+	int nextLabel = 1;
+
+	for (int i = 0; i < n; i++)
+	{
+		perm[i] = i;
+	}
+	bisect(g, perm, 0, n, 0, &label[0], &mark[0], stamp, nextLabel, tmp);
+}
+
+/**
+ * Greedy multicolouring, rows of a colour are independent of each other, so
+ * after sorting by colour the triangular solves of an ILU(0) have at most
+ * as many levels as there are colours.
+ */
+static int orderColour(const ooo_graph &g, int *perm)
+{
+	int n = g.iNumVertices;
+	std::vector<int> colour(n, -1);
+	std::vector<int> lastUse;
+	int numColours = 0;
+
+	for (int v = 0; v < n; v++)
+	{
+		// lastUse[c] == v marks colour c as taken by a neighbour
+		for (int64_t k = g.adjPtr[v]; k < g.adjPtr[v+1]; k++)
+		{
+			int c = colour[g.adj[k]];
+			if (c >= 0)
+			{
+				lastUse[c] = v;
+			}
+		}
+		int c = 0;
+		while (c < numColours && lastUse[c] == v)
+		{
+			c++;
+		}
+		if (c == numColours)
+		{
+			lastUse.push_back(-1);
+			numColours++;
+		}
+		colour[v] = c;
+	}
+
+	// stable bucket sort by colour
+	std::vector<int> colourPtr(numColours + 1, 0);
+	for (int v = 0; v < n; v++)
+	{
+		colourPtr[colour[v] + 1]++;
+	}
+	for (int c = 0; c < numColours; c++)
+	{
+		colourPtr[c+1] += colourPtr[c];
+	}
+	for (int v = 0; v < n; v++)
+	{
+		perm[colourPtr[colour[v]]++] = v;
+	}
+	return numColours;
+}
+
+// maximum and mean distance of the nonzeros from the diagonal
+static void bandwidth(ooo_input *tInput, long &maxDist, double &avgDist)
+{
+	long maxD = 0;
+	double sumD = 0.0;
+
+	#pragma omp parallel for reduction(max:maxD) reduction(+:sumD)
+	for (int i = 0; i < tInput->stNumRows; i++)
+	{
+		for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1]; nz++)
+		{
+			long d = std::labs((long) tInput->col[nz] - i);
+			maxD = std::max(maxD, d);
+			sumD += d;
+		}
+	}
+	maxDist = maxD;
+	avgDist = sumD / std::max<int64_t>(tInput->stNumNonzeros, 1);
+}
+
+bool reorderMatrix(ooo_input *tInput, int iMethod, ooo_reorder *tReorder)
+{
+	int n = tInput->stNumRows;
+	for (int64_t nz = 0; nz < tInput->stNumNonzeros; nz++)
+	{
+		if (tInput->col[nz] < 0 || tInput->col[nz] >= n)
+		{
+			std::cerr << "WARNING: matrix is not square, skipping reordering" << std::endl;
+			return false;
+		}
+	}
+
+	double t1 = omp_get_wtime();
+	long maxBefore, maxAfter;
+	double avgBefore, avgAfter;
+	bandwidth(tInput, maxBefore, avgBefore);
+
+	ooo_graph g;
+	buildGraph(tInput, g);
+	tReorder->iNumRows = n;
+	tReorder->perm = new int[n];
+	tReorder->iperm = new int[n];
+	int numColours = 0;
+	if (iMethod == REORDER_RCM)
+	{
+		orderRcm(g, tReorder->perm);
+	}
+	else if (iMethod == REORDER_COLOUR)
+	{
+		numColours = orderColour(g, tReorder->perm);
+	}
+	else
+	{
+		orderPartition(g, tReorder->perm);
+	}
+	for (int i = 0; i < n; i++)
+	{
+		tReorder->iperm[tReorder->perm[i]] = i;
+	}
+
+	// permute into scratch arrays, then back into the input's storage,
+	// which may be a private mapping of the binary cache
+	const int *perm = tReorder->perm;
+	const int *iperm = tReorder->iperm;
+	int64_t *row = new int64_t[n + 1];
+	int *col = new int[tInput->stNumNonzeros];
+	double *val = new double[tInput->stNumNonzeros];
+	row[0] = 0;
+	for (int i = 0; i < n; i++)
+	{
+		row[i+1] = row[i] + (tInput->row[perm[i]+1] - tInput->row[perm[i]]);
+	}
+
+	#pragma omp parallel for schedule(dynamic, 256)
+	for (int i = 0; i < n; i++)
+	{
+		std::vector<std::pair<int, double> > entries;
+		for (int64_t nz = tInput->row[perm[i]]; nz < tInput->row[perm[i]+1]; nz++)
+		{
+			entries.push_back(std::make_pair(iperm[tInput->col[nz]], tInput->val[nz]));
+		}
+		std::sort(entries.begin(), entries.end());
+		for (size_t k = 0; k < entries.size(); k++)
+		{
+			col[row[i] + k] = entries[k].first;
+			val[row[i] + k] = entries[k].second;
+		}
+	}
+
+	memcpy(tInput->row, row, sizeof(int64_t) * (n + 1));
+	memcpy(tInput->col, col, sizeof(int) * tInput->stNumNonzeros);
+	memcpy(tInput->val, val, sizeof(double) * tInput->stNumNonzeros);
+	delete[] row;
+	delete[] col;
+	delete[] val;
+
+	// x follows the columns
+	if (tInput->x != NULL)
+	{
+		double *x = new double[n];
+		#pragma omp parallel for
+		for (int i = 0; i < n; i++)
+		{
+			x[i] = tInput->x[perm[i]];
+		}
+		memcpy(tInput->x, x, sizeof(double) * n);
+		delete[] x;
+	}
+
+	bandwidth(tInput, maxAfter, avgAfter);
+	static const char *methodNames[] = { "none", "rcm", "part", "colour" };
+	std::cout << "Reordering: " << methodNames[iMethod];
+	if (iMethod == REORDER_COLOUR)
+	{
+		std::cout << " (" << numColours << " colours)";
+	}
+	std::cout << ", bandwidth " << maxBefore << " -> " << maxAfter
+		<< ", avg. distance from diagonal " << avgBefore << " -> " << avgAfter
+		<< ", took " << omp_get_wtime() - t1 << " s" << std::endl;
+	return true;
+}
+
+void copyInput(ooo_input *tInput, ooo_input *tCopy)
+{
+	int n = tInput->stNumRows;
+	tCopy->stNumRows = n;
+	tCopy->stNumNonzeros = tInput->stNumNonzeros;
+	tCopy->row = tCopy->tMemory.allocate<int64_t>(n + 1);
+	tCopy->col = tCopy->tMemory.allocate<int>(tInput->stNumNonzeros);
+	tCopy->val = tCopy->tMemory.allocate<double>(tInput->stNumNonzeros);
+	memcpy(tCopy->row, tInput->row, sizeof(int64_t) * (n + 1));
+	memcpy(tCopy->col, tInput->col, sizeof(int) * tInput->stNumNonzeros);
+	memcpy(tCopy->val, tInput->val, sizeof(double) * tInput->stNumNonzeros);
+	tCopy->x = NULL;
+	if (tInput->x != NULL)
+	{
+		tCopy->x = tCopy->tMemory.allocate<double>(n);
+		memcpy(tCopy->x, tInput->x, sizeof(double) * n);
+	}
+}
+
+void unpermuteVector(ooo_reorder *tReorder, int iNumVectors, const double *src, double *dst)
+{
+	const int nv = iNumVectors;
+
+	#pragma omp parallel for
+	for (int i = 0; i < tReorder->iNumRows; i++)
+	{
+		for (int v = 0; v < nv; v++)
+		{
+			dst[(size_t) tReorder->perm[i] * nv + v] = src[(size_t) i * nv + v];
+		}
+	}
+}
+
+void freeReorder(ooo_reorder *tReorder)
+{
+	delete[] tReorder->perm;
+	delete[] tReorder->iperm;
+}
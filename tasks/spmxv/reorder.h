@@ -0,0 +1,30 @@
+#ifndef INC_REORDER_H
+#define INC_REORDER_H
+
+#include "ooo_cmdline.h"
+
+// the partition ordering bisects until the parts have at most this many rows
+#define REORDER_PART_ROWS 4096
+// iterations of the pseudo-peripheral vertex search
+#define REORDER_PERIPHERAL_ITER 8
+
+/**
+ * Symmetric row and column permutation of a square matrix: new row i is old
+ * row perm[i], old row i is new row iperm[i].
+ */
+struct ooo_reorder
+{
+	int				iNumRows;
+	int				*perm;
+	int				*iperm;
+};
+
+// permutes tInput in place, including x if it is set
+bool reorderMatrix(ooo_input *tInput, int iMethod, ooo_reorder *tReorder);
+// matrix and x of tInput in arrays of tCopy->tMemory, the reference for a reordered result
+void copyInput(ooo_input *tInput, ooo_input *tCopy);
+// row-major n x nv src in the new row order to dst in the old one
+void unpermuteVector(ooo_reorder *tReorder, int iNumVectors, const double *src, double *dst);
+void freeReorder(ooo_reorder *tReorder);
+
+#endif
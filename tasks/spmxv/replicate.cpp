@@ -0,0 +1,82 @@
+#include "replicate.h"
+
+#include <sched.h>
+#include <string.h>
+
+#include <omp.h>
+#include <numa.h>
+
+#include <algorithm>
+#include <iostream>
+
+bool replicateVector(const double *x, size_t stSize, ooo_replicas *tRep)
+{
+	if (numa_available() < 0)
+	{
+		std::cerr << "ERROR: x replication needs NUMA support" << std::endl;
+		return false;
+	}
+
+	int maxNode = numa_max_node();
+	tRep->iNumCpus = numa_num_configured_cpus();
+	tRep->stSize = stSize;
+	tRep->copy = new double*[maxNode + 1];
+	tRep->cpuNode = new int[tRep->iNumCpus];
+	tRep->iNumNodes = 0;
+
+	// one copy per node with memory, cpus of memoryless nodes use the first copy
+	int *replicaOfNode = new int[maxNode + 1];
+	for (int node = 0; node <= maxNode; node++)
+	{
+		replicaOfNode[node] = 0;
+		if (numa_bitmask_isbitset(numa_all_nodes_ptr, node))
+		{
+			double *copy = (double*) numa_alloc_onnode(std::max<size_t>(stSize, 1), node);
+			if (copy == NULL)
+			{
+				continue;
+			}
+			// the pages are bound to the node, any thread can fill them
+			size_t count = stSize / sizeof(double);
+			#pragma omp parallel for schedule(static)
+			for (size_t i = 0; i < count; i++)
+			{
+				copy[i] = x[i];
+			}
+			replicaOfNode[node] = tRep->iNumNodes;
+			tRep->copy[tRep->iNumNodes++] = copy;
+		}
+	}
+	for (int cpu = 0; cpu < tRep->iNumCpus; cpu++)
+	{
+		int node = numa_node_of_cpu(cpu);
+		tRep->cpuNode[cpu] = (node >= 0 && node <= maxNode) ? replicaOfNode[node] : 0;
+	}
+	delete[] replicaOfNode;
+
+	if (tRep->iNumNodes == 0)
+	{
+		std::cerr << "ERROR: could not allocate x on any NUMA node" << std::endl;
+		delete[] tRep->copy;
+		delete[] tRep->cpuNode;
+		return false;
+	}
+	std::cout << "x replicated on " << tRep->iNumNodes << " NUMA node(s)" << std::endl;
+	return true;
+}
+
+const double *localReplica(const ooo_replicas *tRep)
+{
+	int cpu = sched_getcpu();
+	return tRep->copy[(cpu >= 0 && cpu < tRep->iNumCpus) ? tRep->cpuNode[cpu] : 0];
+}
+
+void freeReplicas(ooo_replicas *tRep)
+{
+	for (int k = 0; k < tRep->iNumNodes; k++)
+	{
+		numa_free(tRep->copy[k], std::max<size_t>(tRep->stSize, 1));
+	}
+	delete[] tRep->copy;
+	delete[] tRep->cpuNode;
+}
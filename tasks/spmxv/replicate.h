@@ -0,0 +1,24 @@
+#ifndef INC_REPLICATE_H
+#define INC_REPLICATE_H
+
+#include <stddef.h>
+
+/**
+ * Read-only copies of a vector, one on every NUMA node with memory.
+ * cpuNode maps a cpu to the replica of its node.
+ */
+struct ooo_replicas
+{
+	int				iNumNodes;
+	int				iNumCpus;
+	double			**copy;
+	int				*cpuNode;
+	size_t			stSize;			// bytes of one copy
+};
+
+bool replicateVector(const double *x, size_t stSize, ooo_replicas *tRep);
+// the copy on the node of the calling thread's cpu
+const double *localReplica(const ooo_replicas *tRep);
+void freeReplicas(ooo_replicas *tRep);
+
+#endif
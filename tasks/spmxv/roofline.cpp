@@ -0,0 +1,121 @@
+#include "roofline.h"
+
+#include <omp.h>
+#include <numa.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#define CACHE_LINE 64
+
+static long lastLevelCache()
+{
+	long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+	if (llc <= 0)
+	{
+		llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	}
+	return (llc > 0) ? llc : ROOFLINE_DEFAULT_LLC;
+}
+
+double streamTriad(int iNumThreads)
+{
+	long memory = sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+	long arrayBytes = std::max(4 * lastLevelCache(), 64L << 20);
+	if (memory > 0)
+	{
+		arrayBytes = std::min(arrayBytes, memory / 12);
+	}
+	long n = arrayBytes / sizeof(double);
+	double *a = (double*) numa_alloc(sizeof(double) * n);
+	double *b = (double*) numa_alloc(sizeof(double) * n);
+	double *c = (double*) numa_alloc(sizeof(double) * n);
+	if (a == NULL || b == NULL || c == NULL)
+	{
+		std::cerr << "ERROR: could not allocate the STREAM arrays, skipping the measurement" << std::endl;
+		if (a != NULL)
+		{
+			numa_free(a, sizeof(double) * n);
+		}
+		if (b != NULL)
+		{
+			numa_free(b, sizeof(double) * n);
+		}
+		if (c != NULL)
+		{
+			numa_free(c, sizeof(double) * n);
+		}
+		return 0.0;
+	}
+	const double s = 3.0;
+	double dBest = 0.0;
+
+	#pragma omp parallel num_threads(iNumThreads) proc_bind(spread)
+	{
+		int tid = omp_get_thread_num();
+		int nt = omp_get_num_threads();
+		long beg = n * tid / nt;
+		long end = n * (tid + 1) / nt;
+		for (long i = beg; i < end; i++)
+		{
+			a[i] = 0.0;
+			b[i] = 1.0;
+			c[i] = 2.0;
+		}
+
+		for (int rep = 0; rep < STREAM_REPS; rep++)
+		{
+			#pragma omp barrier
+			double t1 = omp_get_wtime();
+			#pragma omp simd
+			for (long i = beg; i < end; i++)
+			{
+				a[i] = b[i] + s * c[i];
+			}
+			#pragma omp barrier
+			#pragma omp master
+			{
+				double d = omp_get_wtime() - t1;
+				dBest = std::max(dBest, 3.0 * sizeof(double) * n / d / 1e9);
+			}
+		}
+	}
+
+	numa_free(a, sizeof(double) * n);
+	numa_free(b, sizeof(double) * n);
+	numa_free(c, sizeof(double) * n);
+	return dBest;
+}
+
+void estimateVectorTraffic(ooo_input *tInput, ooo_partition *tPart, int nv, ooo_roofline *tRoofline)
+{
+	long rowBytes = (long) nv * sizeof(double);
+	long xLines = ((long) tInput->stNumRows * rowBytes + CACHE_LINE - 1) / CACHE_LINE;
+	long lines = std::min(std::max(lastLevelCache() / tPart->iNumParts / CACHE_LINE, 1L), std::max(xLines, 1L));
+	long misses = 0;
+
+	#pragma omp parallel for schedule(dynamic, 1) reduction(+:misses)
+	for (int t = 0; t < tPart->iNumParts; t++)
+	{
+		std::vector<long> tag(lines, -1);
+		for (int64_t nz = tInput->row[tPart->rowPtr[t]]; nz < tInput->row[tPart->rowPtr[t+1]]; nz++)
+		{
+			long first = tInput->col[nz] * rowBytes / CACHE_LINE;
+			long last = (tInput->col[nz] * rowBytes + rowBytes - 1) / CACHE_LINE;
+			for (long line = first; line <= last; line++)
+			{
+				if (tag[line % lines] != line)
+				{
+					tag[line % lines] = line;
+					misses++;
+				}
+			}
+		}
+	}
+
+	tRoofline->dXBytes = (double) misses * CACHE_LINE;
+	tRoofline->dYBytes = (double) tInput->stNumRows * rowBytes;
+	tRoofline->dCacheBytes = (double) lastLevelCache();
+}
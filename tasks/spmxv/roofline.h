@@ -0,0 +1,30 @@
+#ifndef INC_ROOFLINE_H
+#define INC_ROOFLINE_H
+
+#include "ooo_cmdline.h"
+#include "csr.h"
+
+// STREAM triad repetitions, the fastest one is reported
+#define STREAM_REPS 5
+// LLC size assumed if the system does not report one
+#define ROOFLINE_DEFAULT_LLC (32L << 20)
+
+/**
+ * STREAM triad a = b + s * c on arrays of four times the last level cache
+ * (at most a quarter of the memory in total), first touched and run in
+ * contiguous blocks by iNumThreads threads with proc_bind(spread) like the
+ * kernels. Counts 24 bytes per element as STREAM does.
+ * @return bandwidth in GB/s, 0 if the arrays cannot be allocated
+ */
+double streamTriad(int iNumThreads);
+
+/**
+ * Fills the x and y traffic of tRoofline for one SpMV with nv vectors. y
+ * is written once. x traffic is the number of misses of a direct-mapped
+ * cache of the LLC share of each thread, simulated over the column
+ * accesses of its rows in CSR order, times the line size. Also records
+ * the LLC size.
+ */
+void estimateVectorTraffic(ooo_input *tInput, ooo_partition *tPart, int nv, ooo_roofline *tRoofline);
+
+#endif
@@ -0,0 +1,651 @@
+#include "solver.h"
+#include "persistent.h"
+#include "reorder.h"
+#include "precond.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// work vectors besides b and x
+#define SOLVER_NUM_WORK 9
+
+static const char *solverNames[] = { "none", "cg", "pipecg", "bicgstab" };
+static const char *precondNames[] = { "none", "jacobi", "ilu0" };
+
+/**
+ * Matrix, vectors and synchronisation shared by the team of a solve.
+ */
+struct ooo_solver_data
+{
+	ooo_partition	*tPart;
+	const int64_t	*Arow;
+	const int		*Acol;
+	const double	*Aval;
+	const double	*b;
+	double			*x;
+	double			*work[SOLVER_NUM_WORK];
+	double			*partial;		// two buffers of iNumParts * SOLVER_PAD partial sums
+	ooo_barrier		tBarrier;
+	ooo_precond		*tPrecond;		// NULL without preconditioning
+};
+
+template<typename F>
+static inline void forOwnRows(const ooo_partition *tPart, int tid, int nt, F f)
+{
+	for (int t = tid; t < tPart->iNumParts; t += nt)
+	{
+		for (int i = tPart->rowPtr[t]; i < tPart->rowPtr[t+1]; i++)
+		{
+			f(i);
+		}
+	}
+}
+
+static inline double rowDot(const ooo_solver_data &d, const double *v, int i)
+{
+	double sum = 0.0;
+	for (int64_t j = d.Arow[i]; j < d.Arow[i+1]; j++)
+	{
+		sum += d.Aval[j] * v[d.Acol[j]];
+	}
+	return sum;
+}
+
+/**
+ * Publishes the thread's partial sums, waits for the team and adds up all
+ * partials in thread order, so every thread gets bit-identical scalars and
+ * takes the same branches. Consecutive reductions alternate between the
+ * two buffers, a buffer is only rewritten after everyone passed the next
+ * barrier.
+ */
+static void allreduce(ooo_solver_data &d, int tid, int nt, int &buf, int &sense, int numValues, const double *mine, double *sums)
+{
+	double *red = d.partial + (size_t) buf * d.tPart->iNumParts * SOLVER_PAD;
+	for (int k = 0; k < numValues; k++)
+	{
+		red[tid * SOLVER_PAD + k] = mine[k];
+	}
+	barrierWait(&d.tBarrier, sense);
+	for (int k = 0; k < numValues; k++)
+	{
+		sums[k] = 0.0;
+		for (int t = 0; t < nt; t++)
+		{
+			sums[k] += red[t * SOLVER_PAD + k];
+		}
+	}
+	buf ^= 1;
+}
+
+// z = M^-1 r by the whole team, the wall time is accumulated per thread
+static inline void precondition(ooo_solver_data &d, int tid, int nt, int &sense, const double *r, double *z, double &dTime, int &iCount)
+{
+	double t1 = omp_get_wtime();
+	applyPrecond(d.tPrecond, tid, nt, &d.tBarrier, sense, r, z);
+	dTime += omp_get_wtime() - t1;
+	iCount++;
+}
+
+static inline void storeStatistics(ooo_solver_result *tResult, int it, bool bConverged, double dApplyTime, int iNumApplies)
+{
+	tResult->iIterations = it;
+	tResult->bConverged = bConverged;
+	tResult->dApplyTime = dApplyTime;
+	tResult->iNumApplies = iNumApplies;
+}
+
+/**
+ * (Preconditioned) conjugate gradients, the dot products are fused into
+ * the SpMV and the update sweeps: three barriers per iteration plus the
+ * preconditioner apply and its reduction.
+ */
+static void solveCg(ooo_solver_data &d, double dTol, int iMaxIter, ooo_solver_result *tResult)
+{
+	const ooo_partition *tPart = d.tPart;
+	const double *b = d.b;
+	double *x = d.x;
+	double *r = d.work[0];
+	double *p = d.work[1];
+	double *q = d.work[2];
+	double *z = d.tPrecond ? d.work[3] : r;
+
+	#pragma omp parallel num_threads(tPart->iNumParts) proc_bind(spread)
+	{
+		int tid = omp_get_thread_num();
+		int nt = omp_get_num_threads();
+		int sense = 0;
+		int buf = 0;
+
+		#pragma omp single
+		initBarrier(&d.tBarrier, nt);
+
+		double applyTime = 0.0;
+		int numApplies = 0;
+		double mine[1] = { 0.0 };
+		double sums[1];
+		forOwnRows(tPart, tid, nt, [&](int i) {
+			x[i] = 0.0;
+			r[i] = b[i];
+			p[i] = b[i];
+			mine[0] += b[i] * b[i];
+		});
+		allreduce(d, tid, nt, buf, sense, 1, mine, sums);
+		const double bb = sums[0];
+		const double limit = dTol * dTol * bb;
+		double rr = bb;
+		double rz = bb;
+		bool bBreakdown = false;
+
+		if (d.tPrecond)
+		{
+			precondition(d, tid, nt, sense, r, z, applyTime, numApplies);
+			mine[0] = 0.0;
+			forOwnRows(tPart, tid, nt, [&](int i) {
+				p[i] = z[i];
+				mine[0] += r[i] * z[i];
+			});
+			allreduce(d, tid, nt, buf, sense, 1, mine, sums);
+			rz = sums[0];
+		}
+
+		int it = 0;
+		while (it < iMaxIter && rr > limit)
+		{
+			// q = A p and p.q
+			mine[0] = 0.0;
+			forOwnRows(tPart, tid, nt, [&](int i) {
+				double s = rowDot(d, p, i);
+				q[i] = s;
+				mine[0] += p[i] * s;
+			});
+			allreduce(d, tid, nt, buf, sense, 1, mine, sums);
+			if (! (sums[0] > 0.0))
+			{
+				bBreakdown = true;
+				break;
+			}
+			double alpha = rz / sums[0];
+
+			// x, r and r.r
+			mine[0] = 0.0;
+			forOwnRows(tPart, tid, nt, [&](int i) {
+				x[i] += alpha * p[i];
+				r[i] -= alpha * q[i];
+				mine[0] += r[i] * r[i];
+			});
+			allreduce(d, tid, nt, buf, sense, 1, mine, sums);
+			rr = sums[0];
+			it++;
+			if (rr <= limit)
+			{
+				break;
+			}
+
+			// z = M^-1 r and r.z
+			double rzNew = rr;
+			if (d.tPrecond)
+			{
+				precondition(d, tid, nt, sense, r, z, applyTime, numApplies);
+				mine[0] = 0.0;
+				forOwnRows(tPart, tid, nt, [&](int i) {
+					mine[0] += r[i] * z[i];
+				});
+				allreduce(d, tid, nt, buf, sense, 1, mine, sums);
+				rzNew = sums[0];
+			}
+			double beta = rzNew / rz;
+			rz = rzNew;
+
+			forOwnRows(tPart, tid, nt, [&](int i) {
+				p[i] = z[i] + beta * p[i];
+			});
+			barrierWait(&d.tBarrier, sense);
+		}
+
+		if (tid == 0)
+		{
+			storeStatistics(tResult, it, ! bBreakdown && rr <= limit, applyTime, numApplies);
+		}
+	}
+}
+
+/**
+ * Pipelined (preconditioned) CG (Ghysels and Vanroose): the recurrences
+ * for s = A p, q = M^-1 s and z = A q let the SpMV n = A M^-1 w, all dot
+ * products and all vector updates run in one sweep, so an iteration needs
+ * a single barrier besides the preconditioner apply. Without
+ * preconditioner u = r, m = w and q = s. w is double-buffered because
+ * other threads still read it in that sweep.
+ */
+static void solvePipeCg(ooo_solver_data &d, double dTol, int iMaxIter, ooo_solver_result *tResult)
+{
+	const ooo_partition *tPart = d.tPart;
+	const double *b = d.b;
+	double *x = d.x;
+	double *r = d.work[0];
+	double *w[2] = { d.work[1], d.work[2] };
+	double *z = d.work[3];
+	double *s = d.work[4];
+	double *p = d.work[5];
+	const bool bPrecond = d.tPrecond != NULL;
+	double *u = bPrecond ? d.work[6] : r;
+	double *m = d.work[7];
+	double *q = bPrecond ? d.work[8] : s;
+
+	#pragma omp parallel num_threads(tPart->iNumParts) proc_bind(spread)
+	{
+		int tid = omp_get_thread_num();
+		int nt = omp_get_num_threads();
+		int sense = 0;
+		int buf = 0;
+
+		#pragma omp single
+		initBarrier(&d.tBarrier, nt);
+
+		double applyTime = 0.0;
+		int numApplies = 0;
+		forOwnRows(tPart, tid, nt, [&](int i) {
+			x[i] = 0.0;
+			r[i] = b[i];
+			z[i] = 0.0;
+			s[i] = 0.0;
+			p[i] = 0.0;
+			q[i] = 0.0;
+		});
+		barrierWait(&d.tBarrier, sense);
+		if (bPrecond)
+		{
+			precondition(d, tid, nt, sense, r, u, applyTime, numApplies);
+		}
+
+		// w = A u, gamma = r.u, delta = w.u and r.r
+		double mine[3] = { 0.0, 0.0, 0.0 };
+		double sums[3];
+		forOwnRows(tPart, tid, nt, [&](int i) {
+			w[0][i] = rowDot(d, u, i);
+			mine[0] += r[i] * u[i];
+			mine[1] += w[0][i] * u[i];
+			mine[2] += r[i] * r[i];
+		});
+		allreduce(d, tid, nt, buf, sense, 3, mine, sums);
+		const double limit = dTol * dTol * sums[2];
+		double gamma = sums[0];
+		double delta = sums[1];
+		double rr = sums[2];
+		double gammaOld = 1.0;
+		double alphaOld = 1.0;
+		bool bBreakdown = false;
+
+		int it = 0;
+		while (it < iMaxIter && rr > limit)
+		{
+			double beta = (it > 0) ? gamma / gammaOld : 0.0;
+			double denom = (it > 0) ? delta - beta * gamma / alphaOld : delta;
+			if (! (denom > 0.0))
+			{
+				bBreakdown = true;
+				break;
+			}
+			double alpha = gamma / denom;
+
+			const double *wCur = w[it & 1];
+			double *wNext = w[(it + 1) & 1];
+			const double *mv = wCur;
+			if (bPrecond)
+			{
+				precondition(d, tid, nt, sense, wCur, m, applyTime, numApplies);
+				mv = m;
+			}
+
+			mine[0] = 0.0;
+			mine[1] = 0.0;
+			mine[2] = 0.0;
+			forOwnRows(tPart, tid, nt, [&](int i) {
+				double n = rowDot(d, mv, i);
+				z[i] = n + beta * z[i];
+				if (bPrecond)
+				{
+					q[i] = mv[i] + beta * q[i];
+				}
+				s[i] = wCur[i] + beta * s[i];
+				p[i] = u[i] + beta * p[i];
+				x[i] += alpha * p[i];
+				r[i] -= alpha * s[i];
+				if (bPrecond)
+				{
+					u[i] -= alpha * q[i];
+				}
+				wNext[i] = wCur[i] - alpha * z[i];
+				mine[0] += r[i] * u[i];
+				mine[1] += wNext[i] * u[i];
+				mine[2] += r[i] * r[i];
+			});
+			allreduce(d, tid, nt, buf, sense, 3, mine, sums);
+			gammaOld = gamma;
+			alphaOld = alpha;
+			gamma = sums[0];
+			delta = sums[1];
+			rr = sums[2];
+			it++;
+		}
+
+		if (tid == 0)
+		{
+			storeStatistics(tResult, it, ! bBreakdown && rr <= limit, applyTime, numApplies);
+		}
+	}
+}
+
+/**
+ * BiCGStab with right preconditioning, each of the five sweeps of an
+ * iteration computes its dot products on the fly.
+ */
+static void solveBiCgStab(ooo_solver_data &d, double dTol, int iMaxIter, ooo_solver_result *tResult)
+{
+	const ooo_partition *tPart = d.tPart;
+	const double *b = d.b;
+	double *x = d.x;
+	double *r = d.work[0];
+	double *rhat = d.work[1];
+	double *p = d.work[2];
+	double *v = d.work[3];
+	double *s = d.work[4];
+	double *t = d.work[5];
+	double *phat = d.tPrecond ? d.work[6] : p;
+	double *shat = d.tPrecond ? d.work[7] : s;
+
+	#pragma omp parallel num_threads(tPart->iNumParts) proc_bind(spread)
+	{
+		int tid = omp_get_thread_num();
+		int nt = omp_get_num_threads();
+		int sense = 0;
+		int buf = 0;
+
+		#pragma omp single
+		initBarrier(&d.tBarrier, nt);
+
+		double applyTime = 0.0;
+		int numApplies = 0;
+		double mine[2] = { 0.0, 0.0 };
+		double sums[2];
+		forOwnRows(tPart, tid, nt, [&](int i) {
+			x[i] = 0.0;
+			r[i] = b[i];
+			rhat[i] = b[i];
+			p[i] = 0.0;
+			v[i] = 0.0;
+			mine[0] += b[i] * b[i];
+		});
+		allreduce(d, tid, nt, buf, sense, 1, mine, sums);
+		const double limit = dTol * dTol * sums[0];
+		double rr = sums[0];
+		double rho = sums[0];
+		double rhoOld = 1.0;
+		double alpha = 1.0;
+		double omega = 1.0;
+		bool bBreakdown = false;
+
+		int it = 0;
+		while (it < iMaxIter && rr > limit)
+		{
+			if (rho == 0.0 || omega == 0.0)
+			{
+				bBreakdown = true;
+				break;
+			}
+			double beta = (rho / rhoOld) * (alpha / omega);
+			forOwnRows(tPart, tid, nt, [&](int i) {
+				p[i] = r[i] + beta * (p[i] - omega * v[i]);
+			});
+			barrierWait(&d.tBarrier, sense);
+			if (d.tPrecond)
+			{
+				precondition(d, tid, nt, sense, p, phat, applyTime, numApplies);
+			}
+
+			// v = A M^-1 p and rhat.v
+			mine[0] = 0.0;
+			forOwnRows(tPart, tid, nt, [&](int i) {
+				v[i] = rowDot(d, phat, i);
+				mine[0] += rhat[i] * v[i];
+			});
+			allreduce(d, tid, nt, buf, sense, 1, mine, sums);
+			if (sums[0] == 0.0)
+			{
+				bBreakdown = true;
+				break;
+			}
+			alpha = rho / sums[0];
+
+			// s = r - alpha v and s.s
+			mine[0] = 0.0;
+			forOwnRows(tPart, tid, nt, [&](int i) {
+				s[i] = r[i] - alpha * v[i];
+				mine[0] += s[i] * s[i];
+			});
+			allreduce(d, tid, nt, buf, sense, 1, mine, sums);
+			if (sums[0] <= limit)
+			{
+				forOwnRows(tPart, tid, nt, [&](int i) {
+					x[i] += alpha * phat[i];
+				});
+				rr = sums[0];
+				it++;
+				break;
+			}
+			if (d.tPrecond)
+			{
+				precondition(d, tid, nt, sense, s, shat, applyTime, numApplies);
+			}
+
+			// t = A M^-1 s, t.s and t.t
+			mine[0] = 0.0;
+			mine[1] = 0.0;
+			forOwnRows(tPart, tid, nt, [&](int i) {
+				t[i] = rowDot(d, shat, i);
+				mine[0] += t[i] * s[i];
+				mine[1] += t[i] * t[i];
+			});
+			allreduce(d, tid, nt, buf, sense, 2, mine, sums);
+			omega = (sums[1] > 0.0) ? sums[0] / sums[1] : 0.0;
+
+			// x, r, rhat.r and r.r
+			mine[0] = 0.0;
+			mine[1] = 0.0;
+			forOwnRows(tPart, tid, nt, [&](int i) {
+				x[i] += alpha * phat[i] + omega * shat[i];
+				r[i] = s[i] - omega * t[i];
+				mine[0] += rhat[i] * r[i];
+				mine[1] += r[i] * r[i];
+			});
+			allreduce(d, tid, nt, buf, sense, 2, mine, sums);
+			rhoOld = rho;
+			rho = sums[0];
+			rr = sums[1];
+			it++;
+		}
+
+		if (tid == 0)
+		{
+			storeStatistics(tResult, it, ! bBreakdown && rr <= limit, applyTime, numApplies);
+		}
+	}
+}
+
+// true relative residual and deviation from x = 1, outside of the time measurement
+static void checkSolution(ooo_solver_data &d, int n, ooo_solver_result *tResult)
+{
+	double rr = 0.0;
+	double bb = 0.0;
+	double err = 0.0;
+
+	#pragma omp parallel for reduction(+:rr, bb) reduction(max:err)
+	for (int i = 0; i < n; i++)
+	{
+		double res = d.b[i] - rowDot(d, d.x, i);
+		rr += res * res;
+		bb += d.b[i] * d.b[i];
+		err = std::max(err, std::fabs(d.x[i] - 1.0));
+	}
+	tResult->dResidual = (bb > 0.0) ? std::sqrt(rr / bb) : std::sqrt(rr);
+	tResult->dError = err;
+}
+
+static void printSolverResults(ooo_options *tOptions, ooo_input *tInput, ooo_solver_result *tResults, int iSpmvPerIter)
+{
+	double dMinTime = numeric_limits<double>::max();
+	double dMeanTime = 0.0;
+	for (int rep = 0; rep < tOptions->iNumRepetitions; rep++)
+	{
+		dMinTime = std::min(dMinTime, tResults[rep].dTime);
+		dMeanTime += tResults[rep].dTime;
+	}
+	dMeanTime /= tOptions->iNumRepetitions;
+
+	const ooo_solver_result &last = tResults[tOptions->iNumRepetitions - 1];
+	int iterations = std::max(last.iIterations, 1);
+	double spmvFlops = (double) tInput->stNumNonzeros / 1e6 * 2. * iSpmvPerIter * iterations;
+
+	std::cout << std::endl;
+	std::cout << "Configuration              " << std::endl;
+	std::cout << "Number of Threads:         " << tOptions->iNumThreads << std::endl;
+	std::cout << "Number of Repetitions:     " << tOptions->iNumRepetitions << std::endl;
+	std::cout << "Input filename:            " << tOptions->strFilename << std::endl;
+	std::cout << "Solver:                    " << solverNames[tOptions->solver] << std::endl;
+	std::cout << "Tolerance:                 " << tOptions->dTolerance << std::endl;
+	std::cout << "Maximum iterations:        " << tOptions->iMaxIterations << std::endl;
+	std::cout << "Preconditioner:            " << precondNames[tOptions->precond] << std::endl;
+	std::cout << std::endl;
+	std::cout << "Solver results             " << std::endl;
+	std::cout << "Converged:                 " << (last.bConverged ? "yes" : "no") << std::endl;
+	std::cout << "Iterations:                " << last.iIterations << std::endl;
+	std::cout << "Relative residual:         " << last.dResidual << std::endl;
+	std::cout << "Max. error (x = 1):        " << last.dError << std::endl;
+	std::cout << "Minimum time to tolerance: " << dMinTime << std::endl;
+	std::cout << "Mean time to tolerance:    " << dMeanTime << std::endl;
+	std::cout << "Mean time per iteration:   " << dMeanTime / iterations << std::endl;
+	std::cout << "SpMV MFlops/s in solve:    " << spmvFlops / dMeanTime << std::endl;
+	if (last.iNumApplies > 0)
+	{
+		std::cout << "Mean time per apply:       " << last.dApplyTime / last.iNumApplies << std::endl;
+	}
+}
+
+bool solverBenchmark(ooo_options *tOptions, ooo_input *tInput)
+{
+	int n = tInput->stNumRows;
+	int iNumRepetitions = tOptions->iNumRepetitions;
+
+	// matrix and vectors are placed by first touch per partition block,
+	// all of them are released by tDevice on return
+	ooo_memory tDevice;
+	ooo_solver_data d;
+	int64_t *Arow = tDevice.allocateNuma<int64_t>(n + 1);
+	int *Acol = tDevice.allocateNuma<int>(tInput->stNumNonzeros);
+	double *Aval = tDevice.allocateNuma<double>(tInput->stNumNonzeros);
+	double *b = tDevice.allocateNuma<double>(n);
+	d.x = tDevice.allocateNuma<double>(n);
+	for (int k = 0; k < SOLVER_NUM_WORK; k++)
+	{
+		d.work[k] = tDevice.allocateNuma<double>(n);
+	}
+	ooo_solver_result *tResults = tDevice.allocate<ooo_solver_result>(iNumRepetitions);
+
+	// the exact solution x = 1 stays the same under a symmetric permutation
+	ooo_reorder tReorder;
+	bool bReordered = tOptions->reorder != REORDER_NONE && reorderMatrix(tInput, tOptions->reorder, &tReorder);
+
+	ooo_partition tPart;
+	partitionRows(tInput->row, n, omp_get_max_threads(), &tPart);
+
+	d.tPart = &tPart;
+	d.partial = tDevice.allocate<double>(2 * tPart.iNumParts * SOLVER_PAD);
+	d.Arow = Arow;
+	d.Acol = Acol;
+	d.Aval = Aval;
+	d.b = b;
+
+	// first touch with the solver's thread placement
+	#pragma omp parallel num_threads(tPart.iNumParts) proc_bind(spread)
+	{
+		for (int t = omp_get_thread_num(); t < tPart.iNumParts; t += omp_get_num_threads())
+		{
+			for (int i = tPart.rowPtr[t]; i < tPart.rowPtr[t+1]; i++)
+			{
+				Arow[i] = tInput->row[i];
+				for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1]; nz++)
+				{
+					Aval[nz] = tInput->val[nz];
+					Acol[nz] = tInput->col[nz];
+				}
+				b[i] = 0.0;
+				d.x[i] = 1.0;
+				for (int k = 0; k < SOLVER_NUM_WORK; k++)
+				{
+					d.work[k][i] = 0.0;
+				}
+			}
+		}
+
+		#pragma omp single
+		Arow[n] = tInput->stNumNonzeros;
+	}
+
+	// b = A * 1
+	spmxvCsr(&tPart, Arow, Acol, Aval, d.x, b);
+
+	ooo_precond tPrecond;
+	d.tPrecond = NULL;
+	bool bSetup = true;
+	if (tOptions->precond != PRECOND_NONE)
+	{
+		bSetup = setupPrecond(tOptions->precond, &tPart, n, Arow, Acol, Aval, &tPrecond);
+		d.tPrecond = &tPrecond;
+	}
+
+	int iSpmvPerIter = (tOptions->solver == SOLVER_BICGSTAB) ? 2 : 1;
+	for (int rep = 0; bSetup && rep < iNumRepetitions; rep++)
+	{
+		double t1 = omp_get_wtime();
+		switch (tOptions->solver)
+		{
+		case SOLVER_PIPECG:
+			solvePipeCg(d, tOptions->dTolerance, tOptions->iMaxIterations, &tResults[rep]);
+			break;
+		case SOLVER_BICGSTAB:
+			solveBiCgStab(d, tOptions->dTolerance, tOptions->iMaxIterations, &tResults[rep]);
+			break;
+		default:
+			solveCg(d, tOptions->dTolerance, tOptions->iMaxIterations, &tResults[rep]);
+			break;
+		}
+		tResults[rep].dTime = omp_get_wtime() - t1;
+		checkSolution(d, n, &tResults[rep]);
+	}
+
+	bool bConverged = false;
+	if (bSetup)
+	{
+		printSolverResults(tOptions, tInput, tResults, iSpmvPerIter);
+		bConverged = tResults[iNumRepetitions - 1].bConverged;
+		if (! bConverged)
+		{
+			std::cerr << "ERROR: solver did not reach the tolerance" << std::endl;
+		}
+	}
+
+	// cleanup, the arrays of tDevice are released on return
+	if (d.tPrecond != NULL && bSetup)
+	{
+		freePrecond(&tPrecond);
+	}
+	freePartition(&tPart);
+	if (bReordered)
+	{
+		freeReorder(&tReorder);
+	}
+	return bConverged;
+}
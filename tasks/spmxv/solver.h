@@ -0,0 +1,26 @@
+#ifndef INC_SOLVER_H
+#define INC_SOLVER_H
+
+#include "ooo_cmdline.h"
+#include "csr.h"
+
+// per-thread partial sums are kept one cache line apart
+#define SOLVER_PAD 8
+
+/**
+ * Outcome of one solve, the residual is the true one, ||b - A x|| / ||b||.
+ */
+struct ooo_solver_result
+{
+	int				iIterations;
+	bool			bConverged;
+	double			dResidual;
+	double			dError;			// max. deviation from the exact solution x = 1
+	double			dTime;
+	double			dApplyTime;		// spent in the preconditioner
+	int				iNumApplies;
+};
+
+bool solverBenchmark(ooo_options *tOptions, ooo_input *tInput);
+
+#endif
@@ -0,0 +1,195 @@
+#include "symmetric.h"
+
+#include <omp.h>
+#include <numa.h>
+
+#include <algorithm>
+#include <iostream>
+
+// position of column c in row i, or -1
+static int64_t findEntry(ooo_input *tInput, int i, int c)
+{
+	const int *beg = tInput->col + tInput->row[i];
+	const int *end = tInput->col + tInput->row[i+1];
+	const int *pos = std::lower_bound(beg, end, c);
+	if (pos == end || *pos != c)
+	{
+		// rows are not guaranteed to be sorted
+		pos = std::find(beg, end, c);
+	}
+	return (pos == end) ? -1 : (int64_t) (pos - tInput->col);
+}
+
+bool isSymmetric(ooo_input *tInput)
+{
+	bool bSymmetric = true;
+
+	#pragma omp parallel for schedule(dynamic, 256) reduction(&&:bSymmetric)
+	for (int i = 0; i < tInput->stNumRows; i++)
+	{
+		for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1] && bSymmetric; nz++)
+		{
+			int c = tInput->col[nz];
+			int64_t t = (c < tInput->stNumRows) ? findEntry(tInput, c, i) : -1;
+			bSymmetric = (t >= 0) && (tInput->val[t] == tInput->val[nz]);
+		}
+	}
+	return bSymmetric;
+}
+
+void convertToSymmetric(ooo_input *tInput, int iNumParts, ooo_sym *tSym)
+{
+	int n = tInput->stNumRows;
+	tSym->iNumRows = n;
+
+	// strict upper triangle row pointers
+	tSym->row = new int64_t[n + 1];
+	tSym->row[0] = 0;
+	for (int i = 0; i < n; i++)
+	{
+		int count = 0;
+		for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1]; nz++)
+		{
+			count += (tInput->col[nz] > i);
+		}
+		tSym->row[i+1] = tSym->row[i] + count;
+	}
+	tSym->stNumStored = tSym->row[n];
+
+	partitionRows(tSym->row, n, iNumParts, &tSym->tPart);
+	ooo_partition &tPart = tSym->tPart;
+
+	// every buffer covers the thread's rows and the columns they reach
+	tSym->bufEnd = new int[iNumParts];
+	tSym->bufOffset = new size_t[iNumParts + 1];
+	tSym->firstOverlap = new int[iNumParts];
+	tSym->bufOffset[0] = 0;
+	for (int t = 0; t < iNumParts; t++)
+	{
+		int end = tPart.rowPtr[t+1];
+		for (int i = tPart.rowPtr[t]; i < tPart.rowPtr[t+1]; i++)
+		{
+			for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1]; nz++)
+			{
+				end = std::max(end, tInput->col[nz] + 1);
+			}
+		}
+		tSym->bufEnd[t] = end;
+		tSym->bufOffset[t+1] = tSym->bufOffset[t] + (end - tPart.rowPtr[t]);
+	}
+	for (int t = 0; t < iNumParts; t++)
+	{
+		int s = 0;
+		while (s < t && tSym->bufEnd[s] <= tPart.rowPtr[t])
+		{
+			s++;
+		}
+		tSym->firstOverlap[t] = s;
+	}
+	tSym->stBufSize = tSym->bufOffset[iNumParts];
+
+	tSym->col = (int*) numa_alloc(sizeof(int) * std::max<size_t>(tSym->stNumStored, 1));
+	tSym->val = (double*) numa_alloc(sizeof(double) * std::max<size_t>(tSym->stNumStored, 1));
+	tSym->diag = (double*) numa_alloc(sizeof(double) * std::max(n, 1));
+	tSym->buf = (double*) numa_alloc(sizeof(double) * std::max<size_t>(tSym->stBufSize, 1));
+
+	// fill with the kernel's thread placement (first touch)
+	#pragma omp parallel num_threads(iNumParts) proc_bind(spread)
+	{
+		for (int t = omp_get_thread_num(); t < iNumParts; t += omp_get_num_threads())
+		{
+			for (size_t k = tSym->bufOffset[t]; k < tSym->bufOffset[t+1]; k++)
+			{
+				tSym->buf[k] = 0.0;
+			}
+			for (int i = tPart.rowPtr[t]; i < tPart.rowPtr[t+1]; i++)
+			{
+				int64_t pos = tSym->row[i];
+				tSym->diag[i] = 0.0;
+				for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1]; nz++)
+				{
+					int c = tInput->col[nz];
+					if (c == i)
+					{
+						tSym->diag[i] += tInput->val[nz];
+					}
+					else if (c > i)
+					{
+						tSym->col[pos] = c;
+						tSym->val[pos] = tInput->val[nz];
+						pos++;
+					}
+				}
+			}
+		}
+	}
+
+	size_t overlap = tSym->stBufSize - n;
+	std::cout << "Symmetric storage: " << tSym->stNumStored << " off-diagonal entries stored of "
+		<< tInput->stNumNonzeros << " nonzeros, " << overlap << " rows of buffer overlap" << std::endl;
+}
+
+void spmxvSymmetric(ooo_sym *tSym, const double *x, double *y)
+{
+	const ooo_partition &tPart = tSym->tPart;
+	const int64_t * __restrict__ row = tSym->row;
+	const int     * __restrict__ col = tSym->col;
+	const double  * __restrict__ val = tSym->val;
+
+	#pragma omp parallel num_threads(tPart.iNumParts) proc_bind(spread)
+	{
+		for (int t = omp_get_thread_num(); t < tPart.iNumParts; t += omp_get_num_threads())
+		{
+			int r0 = tPart.rowPtr[t];
+			double * __restrict__ buf = tSym->buf + tSym->bufOffset[t];
+			for (int k = 0; k < tSym->bufEnd[t] - r0; k++)
+			{
+				buf[k] = 0.0;
+			}
+
+			for (int i = r0; i < tPart.rowPtr[t+1]; i++)
+			{
+				const double xi = x[i];
+				double sum = tSym->diag[i] * xi;
+				for (int64_t j = row[i]; j < row[i+1]; j++)
+				{
+					sum += val[j] * x[col[j]];
+					buf[col[j] - r0] += val[j] * xi;
+				}
+				buf[i - r0] += sum;
+			}
+		}
+
+		#pragma omp barrier
+
+		// y = sum of all buffers covering the row
+		for (int t = omp_get_thread_num(); t < tPart.iNumParts; t += omp_get_num_threads())
+		{
+			for (int i = tPart.rowPtr[t]; i < tPart.rowPtr[t+1]; i++)
+			{
+				double sum = 0.0;
+				for (int s = tSym->firstOverlap[t]; s <= t; s++)
+				{
+					if (i < tSym->bufEnd[s])
+					{
+						sum += tSym->buf[tSym->bufOffset[s] + (i - tPart.rowPtr[s])];
+					}
+				}
+				y[i] = sum;
+			}
+		}
+	}
+}
+
+void freeSymmetric(ooo_sym *tSym)
+{
+	numa_free(tSym->col, sizeof(int) * std::max<size_t>(tSym->stNumStored, 1));
+	numa_free(tSym->val, sizeof(double) * std::max<size_t>(tSym->stNumStored, 1));
+	numa_free(tSym->diag, sizeof(double) * std::max(tSym->iNumRows, 1));
+	numa_free(tSym->buf, sizeof(double) * std::max<size_t>(tSym->stBufSize, 1));
+	freePartition(&tSym->tPart);
+	delete[] tSym->row;
+	delete[] tSym->bufEnd;
+	delete[] tSym->bufOffset;
+	delete[] tSym->firstOverlap;
+}
@@ -0,0 +1,36 @@
+#ifndef INC_SYMMETRIC_H
+#define INC_SYMMETRIC_H
+
+#include <stddef.h>
+
+#include "ooo_cmdline.h"
+#include "csr.h"
+
+/**
+ * Symmetric storage: diagonal plus strict upper triangle in CSR. Every
+ * stored entry a_ij contributes a_ij*x_j to y_i and a_ij*x_i to y_j. The
+ * transposed contributions of a thread's rows land in a private buffer
+ * covering rows rowPtr[t] .. bufEnd[t]-1, which are summed up afterwards.
+ */
+struct ooo_sym
+{
+	int				iNumRows;
+	ooo_partition	tPart;			// balanced over the stored entries
+	int64_t			*row;
+	int				*col;
+	double			*val;
+	double			*diag;
+	int				*bufEnd;
+	size_t			*bufOffset;		// buffer of thread t starts at buf + bufOffset[t]
+	int				*firstOverlap;	// first thread whose buffer reaches into the rows of thread t
+	double			*buf;
+	size_t			stNumStored;
+	size_t			stBufSize;
+};
+
+bool isSymmetric(ooo_input *tInput);
+void convertToSymmetric(ooo_input *tInput, int iNumParts, ooo_sym *tSym);
+void spmxvSymmetric(ooo_sym *tSym, const double *x, double *y);
+void freeSymmetric(ooo_sym *tSym);
+
+#endif
@@ -0,0 +1,313 @@
+#include "transpose.h"
+
+#include <omp.h>
+#include <numa.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "ooo_bincache.h"
+#include "ooo_verify.h"
+
+void transposeMatrix(ooo_input *tInput, ooo_input *tTrans)
+{
+	int n = tInput->stNumRows;
+	int64_t nnz = tInput->stNumNonzeros;
+	tTrans->stNumRows = n;
+	tTrans->stNumNonzeros = nnz;
+	tTrans->row = tTrans->tMemory.allocate<int64_t>(n + 1);
+	tTrans->col = tTrans->tMemory.allocate<int>(nnz);
+	tTrans->val = tTrans->tMemory.allocate<double>(nnz);
+	tTrans->x = NULL;
+
+	// nonzeros per column
+	int64_t *next = new int64_t[n + 1];
+	std::fill(next, next + n + 1, 0);
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n; i++)
+	{
+		for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1]; nz++)
+		{
+			#pragma omp atomic
+			next[tInput->col[nz] + 1]++;
+		}
+	}
+	for (int c = 0; c < n; c++)
+	{
+		next[c+1] += next[c];
+	}
+	std::copy(next, next + n + 1, tTrans->row);
+
+	// entries of a column arrive in any order
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n; i++)
+	{
+		for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1]; nz++)
+		{
+			int64_t pos;
+			#pragma omp atomic capture
+			pos = next[tInput->col[nz]]++;
+			tTrans->col[pos] = i;
+			tTrans->val[pos] = tInput->val[nz];
+		}
+	}
+	delete[] next;
+
+	// sorted rows keep the summation order of the kernel fixed
+	#pragma omp parallel
+	{
+		std::vector<std::pair<int, double> > entries;
+		#pragma omp for schedule(dynamic, 256)
+		for (int c = 0; c < n; c++)
+		{
+			int64_t beg = tTrans->row[c];
+			int64_t end = tTrans->row[c+1];
+			entries.clear();
+			for (int64_t k = beg; k < end; k++)
+			{
+				entries.push_back(std::make_pair(tTrans->col[k], tTrans->val[k]));
+			}
+			std::sort(entries.begin(), entries.end());
+			for (int64_t k = beg; k < end; k++)
+			{
+				tTrans->col[k] = entries[k - beg].first;
+				tTrans->val[k] = entries[k - beg].second;
+			}
+		}
+	}
+}
+
+void freeTransposed(ooo_input *tTrans)
+{
+	tTrans->tMemory.release();
+}
+
+// half the currently free physical memory
+static double defaultBudget()
+{
+	return 0.5 * (double) sysconf(_SC_AVPHYS_PAGES) * (double) sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * Every thread's buffer covers the columns its rows reach, so banded
+ * matrices need little more than n entries in total.
+ */
+static void setupBuffers(ooo_input *tInput, ooo_partition *tPart, ooo_transpose *tT)
+{
+	int P = tPart->iNumParts;
+	tT->bufBegin = new int[P];
+	tT->bufEnd = new int[P];
+	tT->bufOffset = new size_t[P + 1];
+
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int t = 0; t < P; t++)
+	{
+		int beg = tInput->stNumRows;
+		int end = 0;
+		for (int64_t nz = tInput->row[tPart->rowPtr[t]]; nz < tInput->row[tPart->rowPtr[t+1]]; nz++)
+		{
+			beg = std::min(beg, tInput->col[nz]);
+			end = std::max(end, tInput->col[nz] + 1);
+		}
+		tT->bufBegin[t] = std::min(beg, end);
+		tT->bufEnd[t] = end;
+	}
+	tT->bufOffset[0] = 0;
+	for (int t = 0; t < P; t++)
+	{
+		tT->bufOffset[t+1] = tT->bufOffset[t] + (tT->bufEnd[t] - tT->bufBegin[t]);
+	}
+	tT->stBufSize = tT->bufOffset[P];
+	tT->buf = (double*) numa_alloc(sizeof(double) * std::max<size_t>(tT->stBufSize, 1));
+
+	// first touch by the owning thread
+	#pragma omp parallel num_threads(P) proc_bind(spread)
+	{
+		for (int t = omp_get_thread_num(); t < P; t += omp_get_num_threads())
+		{
+			std::fill(tT->buf + tT->bufOffset[t], tT->buf + tT->bufOffset[t+1], 0.0);
+		}
+	}
+
+	std::cout << "Transpose: private buffers of " << tT->stBufSize << " entries, "
+		<< (double) tT->stBufSize / std::max(tInput->stNumRows, 1) << " x the columns" << std::endl;
+}
+
+/**
+ * A^T from the cache <filename>.T.bin if it is up to date, else built and
+ * cached, then copied to arrays first touched by the rows of A^T.
+ */
+static void setupCsc(ooo_options *tOptions, ooo_input *tInput, int iNumParts, ooo_transpose *tT)
+{
+	// a reordered matrix no longer matches its file
+	struct stat source;
+	std::string strCache = tOptions->strFilename + ".T.bin";
+	bool bCache = tOptions->useCache && ! tOptions->createMat && tOptions->reorder == REORDER_NONE &&
+		stat(tOptions->strFilename.c_str(), &source) == 0;
+
+	ooo_input tSource;
+	bool bMapped = bCache && mapBinaryMatrix(strCache, &source, &tSource) &&
+		tSource.stNumRows == tInput->stNumRows && tSource.stNumNonzeros == tInput->stNumNonzeros;
+	if (! bMapped)
+	{
+		transposeMatrix(tInput, &tSource);
+		if (bCache)
+		{
+			writeBinaryMatrix(strCache, &source, tInput->stNumRows, &tSource);
+		}
+	}
+
+	int n = tSource.stNumRows;
+	int64_t nnz = tSource.stNumNonzeros;
+	ooo_input &tCsc = tT->tCsc;
+	tCsc.stNumRows = n;
+	tCsc.stNumNonzeros = nnz;
+	tCsc.x = NULL;
+	tCsc.row = tCsc.tMemory.allocateNuma<int64_t>(n + 1);
+	tCsc.col = tCsc.tMemory.allocateNuma<int>(nnz);
+	tCsc.val = tCsc.tMemory.allocateNuma<double>(nnz);
+	partitionRows(tSource.row, n, iNumParts, &tT->tCscPart);
+
+	#pragma omp parallel num_threads(iNumParts) proc_bind(spread)
+	{
+		for (int t = omp_get_thread_num(); t < iNumParts; t += omp_get_num_threads())
+		{
+			for (int i = tT->tCscPart.rowPtr[t]; i < tT->tCscPart.rowPtr[t+1]; i++)
+			{
+				tCsc.row[i] = tSource.row[i];
+				for (int64_t k = tSource.row[i]; k < tSource.row[i+1]; k++)
+				{
+					tCsc.col[k] = tSource.col[k];
+					tCsc.val[k] = tSource.val[k];
+				}
+			}
+		}
+	}
+	tCsc.row[n] = nnz;
+
+	freeTransposed(&tSource);
+
+	std::cout << "Transpose: CSC of " << nnz << " nonzeros" << (bMapped ? " from the cache" : "") << std::endl;
+}
+
+bool setupTranspose(ooo_options *tOptions, ooo_input *tInput, ooo_partition *tPart, ooo_transpose *tT)
+{
+	double dBudget = tOptions->dTransposeBudget > 0.0 ? tOptions->dTransposeBudget : defaultBudget();
+	tT->iNumRows = tInput->stNumRows;
+	tT->tPart = tPart;
+
+	bool bAuto = tOptions->transpose == TRANSPOSE_AUTO;
+	if (bAuto)
+	{
+		double dCscBytes = (double) tInput->stNumNonzeros * (sizeof(double) + sizeof(int)) + sizeof(int64_t) * (tInput->stNumRows + 1.0);
+		tOptions->transpose = (dCscBytes <= dBudget) ? TRANSPOSE_CSC : TRANSPOSE_BUFFERS;
+	}
+	tT->iMethod = tOptions->transpose;
+
+	if (tT->iMethod == TRANSPOSE_CSC)
+	{
+		setupCsc(tOptions, tInput, tPart->iNumParts, tT);
+		return true;
+	}
+
+	setupBuffers(tInput, tPart, tT);
+	if (bAuto && sizeof(double) * (double) tT->stBufSize > dBudget)
+	{
+		std::cerr << "ERROR: neither the CSC copy nor the private buffers of the transpose fit in "
+			<< dBudget / 1e6 << " MB" << std::endl;
+		freeTranspose(tT);
+		return false;
+	}
+	return true;
+}
+
+void spmxvTranspose(ooo_transpose *tT, const int64_t *Arow, const int *Acol, const double *Aval, const double *x, double *y)
+{
+	if (tT->iMethod == TRANSPOSE_CSC)
+	{
+		spmxvCsr(&tT->tCscPart, tT->tCsc.row, tT->tCsc.col, tT->tCsc.val, x, y);
+		return;
+	}
+
+	const ooo_partition &tPart = *tT->tPart;
+	const int64_t * __restrict__ row = Arow;
+	const int     * __restrict__ col = Acol;
+	const double  * __restrict__ val = Aval;
+
+	#pragma omp parallel num_threads(tPart.iNumParts) proc_bind(spread)
+	{
+		// buf_t[j] = sum over the rows i of thread t of a_ij * x_i
+		for (int t = omp_get_thread_num(); t < tPart.iNumParts; t += omp_get_num_threads())
+		{
+			int c0 = tT->bufBegin[t];
+			double * __restrict__ buf = tT->buf + tT->bufOffset[t];
+			for (int k = 0; k < tT->bufEnd[t] - c0; k++)
+			{
+				buf[k] = 0.0;
+			}
+
+			for (int i = tPart.rowPtr[t]; i < tPart.rowPtr[t+1]; i++)
+			{
+				const double xi = x[i];
+				for (int64_t j = row[i]; j < row[i+1]; j++)
+				{
+					buf[col[j] - c0] += val[j] * xi;
+				}
+			}
+		}
+
+		#pragma omp barrier
+
+		// y over the rows thread t first touched, summed from every buffer overlapping them
+		for (int t = omp_get_thread_num(); t < tPart.iNumParts; t += omp_get_num_threads())
+		{
+			int beg = tPart.rowPtr[t];
+			int end = tPart.rowPtr[t+1];
+			for (int j = beg; j < end; j++)
+			{
+				y[j] = 0.0;
+			}
+			for (int s = 0; s < tPart.iNumParts; s++)
+			{
+				const double *buf = tT->buf + tT->bufOffset[s] - tT->bufBegin[s];
+				for (int j = std::max(beg, tT->bufBegin[s]); j < std::min(end, tT->bufEnd[s]); j++)
+				{
+					y[j] += buf[j];
+				}
+			}
+		}
+	}
+}
+
+bool verifyTranspose(ooo_options *tOptions, ooo_input *tInput, ooo_transpose *tT, const double *x, const double *y)
+{
+	if (tT != NULL && tT->iMethod == TRANSPOSE_CSC)
+	{
+		return verifyResult(tOptions, &tT->tCsc, x, y);
+	}
+
+	ooo_input tTrans;
+	transposeMatrix(tInput, &tTrans);
+	bool bCorrect = verifyResult(tOptions, &tTrans, x, y);
+	freeTransposed(&tTrans);
+	return bCorrect;
+}
+
+void freeTranspose(ooo_transpose *tT)
+{
+	if (tT->iMethod == TRANSPOSE_CSC)
+	{
+		tT->tCsc.tMemory.release();
+		freePartition(&tT->tCscPart);
+		return;
+	}
+
+	numa_free(tT->buf, sizeof(double) * std::max<size_t>(tT->stBufSize, 1));
+	delete[] tT->bufBegin;
+	delete[] tT->bufEnd;
+	delete[] tT->bufOffset;
+}
@@ -0,0 +1,53 @@
+#ifndef INC_TRANSPOSE_H
+#define INC_TRANSPOSE_H
+
+#include <stddef.h>
+
+#include "ooo_cmdline.h"
+#include "csr.h"
+
+/**
+ * y = A^T x over the CSR arrays of A, one of two ways:
+ *  buffers  thread t scatters a_ij * x_i of its rows into a private buffer
+ *           covering the columns bufBegin[t] .. bufEnd[t]-1 its rows reach,
+ *           then every thread sums the entries of y it first touched, the
+ *           columns matching its rows, over all buffers
+ *  csc      A^T in CSR (the CSC of A), built once, or taken from the cache
+ *           <filename>.T.bin, and multiplied like any CSR matrix
+ * auto takes csc if the copy fits the memory budget, buffers otherwise.
+ */
+struct ooo_transpose
+{
+	int				iMethod;		// TRANSPOSE_BUFFERS or TRANSPOSE_CSC
+	int				iNumRows;
+	ooo_partition	*tPart;			// rows of A per thread
+	int				*bufBegin;		// buffer of thread t holds columns bufBegin[t] .. bufEnd[t]-1
+	int				*bufEnd;
+	size_t			*bufOffset;		// at buf + bufOffset[t]
+	double			*buf;
+	size_t			stBufSize;
+	ooo_input		tCsc;			// A^T in CSR
+	ooo_partition	tCscPart;		// rows of A^T per thread
+};
+
+/**
+ * A^T in CSR with sorted rows, in arrays of tTrans->tMemory: nonzeros are
+ * counted and placed per column in parallel, then every row is sorted by
+ * column.
+ */
+void transposeMatrix(ooo_input *tInput, ooo_input *tTrans);
+void freeTransposed(ooo_input *tTrans);
+
+/**
+ * Chooses and prepares the method for tOptions->transpose, tPart is kept
+ * for the buffers.
+ * @return false if under auto neither method fits the memory budget
+ */
+bool setupTranspose(ooo_options *tOptions, ooo_input *tInput, ooo_partition *tPart, ooo_transpose *tT);
+void spmxvTranspose(ooo_transpose *tT, const int64_t *Arow, const int *Acol, const double *Aval, const double *x, double *y);
+
+// verifyResult on A^T, built for the check if the buffers were used or tT is NULL
+bool verifyTranspose(ooo_options *tOptions, ooo_input *tInput, ooo_transpose *tT, const double *x, const double *y);
+void freeTranspose(ooo_transpose *tT);
+
+#endif
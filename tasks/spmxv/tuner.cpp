@@ -0,0 +1,470 @@
+#include "tuner.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <omp.h>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "csr.h"
+#include "ellpack.h"
+#include "compressed.h"
+#include "symmetric.h"
+#include "panel.h"
+#include "bcsr.h"
+
+// rows hashed per block of the fingerprint
+#define TUNE_FP_BLOCK 4096
+// a smaller thread count has to be this much faster to be taken
+#define TUNE_THREAD_GAIN 0.97
+
+static const char *formatNames[] = { "csr", "ep", "sell", "csr-rl", "csr-merge", "csr-cmp", "csr-sym", "csr-panel", "auto", "bcsr" };
+
+/**
+ * Format with its parameters, as tried and as stored in the cache.
+ */
+struct ooo_candidate
+{
+	int				iFormat;
+	int				iSellC;
+	int				iNumThreads;
+	double			dTime;
+};
+
+void computeMatrixStats(ooo_input *tInput, ooo_matrix_stats *tStats)
+{
+	int n = tInput->stNumRows;
+	const int64_t *row = tInput->row;
+	const int *col = tInput->col;
+	long histogram[TUNE_HIST_BINS] = {};
+	int minLen = INT_MAX;
+	int maxLen = 0;
+	double sumSq = 0.0;
+	long bandwidth = 0;
+	double sumDistance = 0.0;
+	long reuse = 0;
+
+	#pragma omp parallel for schedule(static) reduction(min:minLen) reduction(max:maxLen, bandwidth) \
+		reduction(+:sumSq, sumDistance, reuse, histogram[:TUNE_HIST_BINS])
+	for (int i = 0; i < n; i++)
+	{
+		int len = (int) (row[i+1] - row[i]);
+		int bin = 0;
+		while (bin < TUNE_HIST_BINS - 1 && (1L << bin) <= len)
+		{
+			bin++;
+		}
+		histogram[bin]++;
+		minLen = std::min(minLen, len);
+		maxLen = std::max(maxLen, len);
+		sumSq += (double) len * len;
+		for (int64_t nz = row[i]; nz < row[i+1]; nz++)
+		{
+			long d = labs((long) col[nz] - i);
+			bandwidth = std::max(bandwidth, d);
+			sumDistance += d;
+			// eight doubles per 64 byte line of x
+			if (nz > row[i] && col[nz] / 8 == col[nz-1] / 8)
+			{
+				reuse++;
+			}
+		}
+	}
+
+	long nnz = tInput->stNumNonzeros;
+	double mean = (double) nnz / std::max(n, 1);
+	tStats->iMinRowLen = (n > 0) ? minLen : 0;
+	tStats->iMaxRowLen = maxLen;
+	tStats->dMeanRowLen = mean;
+	tStats->dRowLenCv = (mean > 0.0) ? sqrt(std::max(sumSq / std::max(n, 1) - mean * mean, 0.0)) / mean : 0.0;
+	std::copy(histogram, histogram + TUNE_HIST_BINS, tStats->histogram);
+	tStats->lBandwidth = bandwidth;
+	tStats->dMeanDistance = sumDistance / std::max(nnz, 1L);
+	tStats->dLineReuse = (double) reuse / std::max(nnz, 1L);
+	tStats->dEllFill = (double) n * maxLen / std::max(nnz, 1L);
+	tStats->bSymmetric = isSymmetric(tInput);
+}
+
+// splitmix64 finaliser of the combined state
+static inline uint64_t mixHash(uint64_t h, uint64_t v)
+{
+	uint64_t z = h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+uint64_t matrixFingerprint(ooo_input *tInput)
+{
+	int n = tInput->stNumRows;
+	int numBlocks = (n + TUNE_FP_BLOCK - 1) / TUNE_FP_BLOCK;
+	std::vector<uint64_t> blockHash(numBlocks);
+
+	#pragma omp parallel for schedule(static)
+	for (int b = 0; b < numBlocks; b++)
+	{
+		uint64_t h = b;
+		for (int i = b * TUNE_FP_BLOCK; i < std::min(n, (b + 1) * TUNE_FP_BLOCK); i++)
+		{
+			h = mixHash(h, tInput->row[i+1] - tInput->row[i]);
+			for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1]; nz++)
+			{
+				uint64_t bits;
+				memcpy(&bits, &tInput->val[nz], sizeof(bits));
+				h = mixHash(mixHash(h, tInput->col[nz]), bits);
+			}
+		}
+		blockHash[b] = h;
+	}
+
+	uint64_t h = mixHash(n, tInput->stNumNonzeros);
+	for (int b = 0; b < numBlocks; b++)
+	{
+		h = mixHash(h, blockHash[b]);
+	}
+	return h;
+}
+
+static void printStats(ooo_input *tInput, ooo_matrix_stats *tStats)
+{
+	std::cout << "Matrix statistics: " << tInput->stNumRows << " rows, row length min " << tStats->iMinRowLen
+		<< " mean " << tStats->dMeanRowLen << " max " << tStats->iMaxRowLen << " (cv " << tStats->dRowLenCv
+		<< "), bandwidth " << tStats->lBandwidth << " (mean distance " << tStats->dMeanDistance
+		<< "), x line reuse " << 100.0 * tStats->dLineReuse << "%, ELLPACK fill " << tStats->dEllFill
+		<< ", symmetric " << (tStats->bSymmetric ? "yes" : "no") << std::endl;
+	std::cout << "Row length histogram:";
+	for (int bin = 0; bin < TUNE_HIST_BINS; bin++)
+	{
+		if (tStats->histogram[bin] > 0)
+		{
+			long lo = (bin == 0) ? 0 : 1L << (bin - 1);
+			long hi = (bin == 0) ? 0 : (1L << bin) - 1;
+			std::cout << " " << lo;
+			if (hi > lo)
+			{
+				std::cout << ".." << hi;
+			}
+			std::cout << ": " << tStats->histogram[bin];
+		}
+	}
+	std::cout << std::endl;
+}
+
+/**
+ * Best time of one repetition of the format on iNumThreads threads, after
+ * converting it like spmxv() does.
+ */
+static double trialFormat(ooo_options *tOptions, ooo_input *tInput, ooo_candidate *tCand, const double *x, double *y)
+{
+	const int64_t *row = tInput->row;
+	const int *col = tInput->col;
+	const double *val = tInput->val;
+	omp_set_num_threads(tCand->iNumThreads);
+	ooo_partition tPart;
+	partitionRows(row, tInput->stNumRows, tCand->iNumThreads, &tPart);
+
+	ooo_ellpack tEll;
+	ooo_sell tSell;
+	ooo_csr_rl tRl;
+	ooo_merge_path tMp;
+	ooo_cmp_csr tCmp;
+	ooo_sym tSym;
+	ooo_panel_csr tPanel;
+	ooo_bcsr tBcsr;
+	switch (tCand->iFormat)
+	{
+	case MFORMAT_ELLPACK:
+		if (! convertToEllpack(tInput, &tEll))
+		{
+			freePartition(&tPart);
+			tCand->dTime = std::numeric_limits<double>::max();
+			return tCand->dTime;
+		}
+		break;
+	case MFORMAT_SELL:
+		if (! convertToSell(tInput, tCand->iSellC, tOptions->sellSigma, &tSell))
+		{
+			freePartition(&tPart);
+			tCand->dTime = std::numeric_limits<double>::max();
+			return tCand->dTime;
+		}
+		break;
+	case MFORMAT_CSR_RL:
+		classifyRows(tInput, &tPart, &tRl);
+		break;
+	case MFORMAT_CSR_MERGE:
+		mergePathPartition(row, tInput->stNumRows, tPart.iNumParts, &tMp);
+		break;
+	case MFORMAT_CSR_CMP:
+		convertToCompressed(tInput, &tPart, tOptions->valuePrecision, &tCmp);
+		break;
+	case MFORMAT_CSR_SYM:
+		convertToSymmetric(tInput, tPart.iNumParts, &tSym);
+		break;
+	case MFORMAT_CSR_PANEL:
+		convertToPanels(tInput, &tPart, tOptions->panelCols > 0 ? tOptions->panelCols : defaultPanelCols(), &tPanel);
+		break;
+	case MFORMAT_BCSR:
+		convertToBcsr(tInput, tOptions->bcsrRows, tOptions->bcsrCols, tPart.iNumParts, &tBcsr);
+		break;
+	}
+
+	// the first repetition warms the caches and is not counted
+	double dBest = std::numeric_limits<double>::max();
+	double dElapsed = 0.0;
+	for (int rep = 0; rep <= TUNE_MIN_REPS || dElapsed < TUNE_TRIAL_SECONDS; rep++)
+	{
+		double t = omp_get_wtime();
+		switch (tCand->iFormat)
+		{
+		case MFORMAT_ELLPACK:
+			spmxvEllpack(&tEll, x, y);
+			break;
+		case MFORMAT_SELL:
+			spmxvSell(&tSell, x, y);
+			break;
+		case MFORMAT_CSR_RL:
+			spmxvCsrRowLength(&tRl, &tPart, row, col, val, x, y);
+			break;
+		case MFORMAT_CSR_MERGE:
+			spmxvCsrMerge(&tMp, row, col, val, x, y);
+			break;
+		case MFORMAT_CSR_CMP:
+			spmxvCompressed(&tCmp, &tPart, row, x, y);
+			break;
+		case MFORMAT_CSR_SYM:
+			spmxvSymmetric(&tSym, x, y);
+			break;
+		case MFORMAT_CSR_PANEL:
+			spmxvPanels(&tPanel, &tPart, x, y);
+			break;
+		case MFORMAT_BCSR:
+			spmxvBcsr(&tBcsr, x, y);
+			break;
+		default:
+			spmxvCsr(&tPart, row, col, val, x, y);
+			break;
+		}
+		double d = omp_get_wtime() - t;
+		if (rep > 0)
+		{
+			dBest = std::min(dBest, d);
+			dElapsed += d;
+		}
+	}
+
+	switch (tCand->iFormat)
+	{
+	case MFORMAT_ELLPACK:
+		freeEllpack(&tEll);
+		break;
+	case MFORMAT_SELL:
+		freeSell(&tSell);
+		break;
+	case MFORMAT_CSR_RL:
+		freeCsrRowLength(&tRl);
+		break;
+	case MFORMAT_CSR_MERGE:
+		freeMergePath(&tMp);
+		break;
+	case MFORMAT_CSR_CMP:
+		freeCompressed(&tCmp);
+		break;
+	case MFORMAT_CSR_SYM:
+		freeSymmetric(&tSym);
+		break;
+	case MFORMAT_CSR_PANEL:
+		freePanels(&tPanel);
+		break;
+	case MFORMAT_BCSR:
+		freeBcsr(&tBcsr);
+		break;
+	}
+	freePartition(&tPart);
+
+	tCand->dTime = dBest;
+	std::cout << "Trial " << formatNames[tCand->iFormat];
+	if (tCand->iFormat == MFORMAT_SELL)
+	{
+		std::cout << " (C " << tCand->iSellC << ")";
+	}
+	std::cout << " on " << tCand->iNumThreads << " threads: " << dBest << " s" << std::endl;
+	return dBest;
+}
+
+// last line of the cache with this key, lines are "fingerprint host max.threads format sell-C threads time"
+static bool lookupCache(const std::string &strCache, uint64_t fp, const char *strHost, int iMaxThreads, ooo_candidate *tCand)
+{
+	FILE *file = fopen(strCache.c_str(), "r");
+	if (file == NULL)
+	{
+		return false;
+	}
+	bool bFound = false;
+	char line[512];
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		unsigned long long key;
+		char host[256];
+		char format[32];
+		int maxThreads;
+		ooo_candidate c;
+		if (sscanf(line, "%llx %255s %d %31s %d %d %lf", &key, host, &maxThreads, format, &c.iSellC, &c.iNumThreads, &c.dTime) != 7 ||
+			key != fp || strcmp(host, strHost) != 0 || maxThreads != iMaxThreads)
+		{
+			continue;
+		}
+		for (int f = 0; f < (int) (sizeof(formatNames) / sizeof(formatNames[0])); f++)
+		{
+			if (strcmp(format, formatNames[f]) == 0 && c.iNumThreads >= 1 && c.iNumThreads <= iMaxThreads)
+			{
+				c.iFormat = f;
+				*tCand = c;
+				bFound = true;
+			}
+		}
+	}
+	fclose(file);
+	return bFound;
+}
+
+static void appendCache(const std::string &strCache, uint64_t fp, const char *strHost, int iMaxThreads, const ooo_candidate *tCand)
+{
+	FILE *file = fopen(strCache.c_str(), "a");
+	if (file == NULL)
+	{
+		std::cerr << "WARNING: could not write the tuning cache " << strCache << std::endl;
+		return;
+	}
+	fprintf(file, "%016llx %s %d %s %d %d %g\n", (unsigned long long) fp, strHost, iMaxThreads,
+		formatNames[tCand->iFormat], tCand->iSellC, tCand->iNumThreads, tCand->dTime);
+	fclose(file);
+}
+
+void tuneFormat(ooo_options *tOptions, ooo_input *tInput)
+{
+	int n = tInput->stNumRows;
+	int maxThreads = omp_get_max_threads();
+
+	ooo_matrix_stats tStats;
+	computeMatrixStats(tInput, &tStats);
+	printStats(tInput, &tStats);
+
+	uint64_t fp = matrixFingerprint(tInput);
+	char host[256] = "unknown";
+	gethostname(host, sizeof(host) - 1);
+	host[sizeof(host) - 1] = '\0';
+
+	ooo_candidate best;
+	bool bCached = ! tOptions->strTuneCache.empty() && lookupCache(tOptions->strTuneCache, fp, host, maxThreads, &best);
+	if (! bCached)
+	{
+		// candidates the statistics allow, plain CSR always
+		std::vector<ooo_candidate> cands;
+		ooo_candidate c = { MFORMAT_CSR, tOptions->sellC, maxThreads, 0.0 };
+		cands.push_back(c);
+		c.iFormat = MFORMAT_CSR_RL;
+		cands.push_back(c);
+		c.iFormat = MFORMAT_CSR_CMP;
+		cands.push_back(c);
+		if (tStats.dRowLenCv > TUNE_IRREGULAR_CV)
+		{
+			c.iFormat = MFORMAT_CSR_MERGE;
+			cands.push_back(c);
+		}
+		if (tStats.dEllFill <= TUNE_MAX_ELL_FILL)
+		{
+			c.iFormat = MFORMAT_ELLPACK;
+			cands.push_back(c);
+		}
+		c.iFormat = MFORMAT_SELL;
+		cands.push_back(c);
+		if (tOptions->sellC != 4 && tStats.dMeanRowLen < 8.0)
+		{
+			// short rows fill narrow chunks better
+			c.iSellC = 4;
+			cands.push_back(c);
+			c.iSellC = tOptions->sellC;
+		}
+		int blockRows = tOptions->bcsrRows;
+		int blockCols = tOptions->bcsrCols;
+		if (blockRows == 0)
+		{
+			detectBlockSize(tInput, &blockRows, &blockCols);
+		}
+		if (blockRows * blockCols > 1)
+		{
+			c.iFormat = MFORMAT_BCSR;
+			cands.push_back(c);
+		}
+		if (tStats.bSymmetric)
+		{
+			c.iFormat = MFORMAT_CSR_SYM;
+			cands.push_back(c);
+		}
+		long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+		if ((long) n * (long) sizeof(double) > ((llc > 0) ? llc : 32L << 20) && tStats.lBandwidth > defaultPanelCols())
+		{
+			// x does not stay in the cache, column panels keep a segment of it there
+			c.iFormat = MFORMAT_CSR_PANEL;
+			cands.push_back(c);
+		}
+
+		double *x = new double[std::max(n, 1)];
+		double *y = new double[std::max(n, 1)];
+		for (int i = 0; i < n; i++)
+		{
+			x[i] = (tInput->x != NULL) ? tInput->x[i] : 1.0;
+		}
+
+		best = cands[0];
+		best.dTime = std::numeric_limits<double>::max();
+		for (size_t k = 0; k < cands.size(); k++)
+		{
+			if (trialFormat(tOptions, tInput, &cands[k], x, y) < best.dTime)
+			{
+				best = cands[k];
+			}
+		}
+
+		// memory bound kernels may be as fast on fewer threads
+		for (int t = maxThreads / 2; t >= 1; t /= 2)
+		{
+			ooo_candidate fewer = best;
+			fewer.iNumThreads = t;
+			if (trialFormat(tOptions, tInput, &fewer, x, y) >= TUNE_THREAD_GAIN * best.dTime)
+			{
+				break;
+			}
+			best = fewer;
+		}
+
+		delete[] x;
+		delete[] y;
+		if (! tOptions->strTuneCache.empty())
+		{
+			appendCache(tOptions->strTuneCache, fp, host, maxThreads, &best);
+		}
+	}
+
+	std::cout << "Autotuning: " << (bCached ? "cached choice " : "chose ") << formatNames[best.iFormat];
+	if (best.iFormat == MFORMAT_SELL)
+	{
+		std::cout << " (C " << best.iSellC << ")";
+	}
+	std::cout << " on " << best.iNumThreads << " threads, " << best.dTime << " s per trial repetition, fingerprint "
+		<< std::hex << fp << std::dec << std::endl;
+
+	tOptions->mformat = best.iFormat;
+	tOptions->sellC = best.iSellC;
+	tOptions->iNumThreads = best.iNumThreads;
+	omp_set_num_threads(best.iNumThreads);
+}
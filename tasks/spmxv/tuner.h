@@ -0,0 +1,53 @@
+#ifndef INC_TUNER_H
+#define INC_TUNER_H
+
+#include <stdint.h>
+
+#include "ooo_cmdline.h"
+
+// a trial repeats its kernel for at least this long after one warm-up run
+#define TUNE_TRIAL_SECONDS 0.05
+#define TUNE_MIN_REPS 3
+// ELLPACK is only tried if the padding grows the matrix by at most this factor
+#define TUNE_MAX_ELL_FILL 1.5
+// merge-path CSR is only tried for row lengths varying more than this (coefficient of variation)
+#define TUNE_IRREGULAR_CV 1.0
+// row length bins 0, 1, 2..3, 4..7, ...
+#define TUNE_HIST_BINS 32
+
+/**
+ * Sparsity statistics the candidate formats are chosen from.
+ */
+struct ooo_matrix_stats
+{
+	int				iMinRowLen;
+	int				iMaxRowLen;
+	double			dMeanRowLen;
+	double			dRowLenCv;		// standard deviation / mean of the row lengths
+	long			histogram[TUNE_HIST_BINS];
+	long			lBandwidth;		// max. |i - j|
+	double			dMeanDistance;	// mean |i - j|
+	double			dLineReuse;		// share of nonzeros reading the x cache line of their predecessor in the row
+	double			dEllFill;		// rows * longest row / nonzeros
+	bool			bSymmetric;
+};
+
+void computeMatrixStats(ooo_input *tInput, ooo_matrix_stats *tStats);
+
+/**
+ * Hash of the dimensions, structure and values, the same for any number
+ * of threads.
+ */
+uint64_t matrixFingerprint(ooo_input *tInput);
+
+/**
+ * Resolves -m auto: prints the matrix statistics, then either takes the
+ * decision cached for the fingerprint, host and maximum thread count, or
+ * runs short trials of the candidate formats the statistics allow on all
+ * threads, halves the thread count of the fastest while that is faster,
+ * and appends the decision to the cache. Sets tOptions->mformat, sellC
+ * and iNumThreads and the OpenMP thread count.
+ */
+void tuneFormat(ooo_options *tOptions, ooo_input *tInput);
+
+#endif
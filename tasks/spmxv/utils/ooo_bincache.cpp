@@ -0,0 +1,216 @@
+#include "ooo_bincache.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <iostream>
+
+static int64_t modificationTime(const struct stat *st)
+{
+	return (int64_t) st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+static uint64_t alignUp(uint64_t offset)
+{
+	return (offset + BINCACHE_ALIGN - 1) / BINCACHE_ALIGN * BINCACHE_ALIGN;
+}
+
+/**
+ * Position-weighted sum of 64 bit words, the trailing partial word is zero
+ * padded. baseWord is the index of the first word within the checksummed
+ * region, so sections can be summed separately.
+ */
+static uint64_t checksum(const char *data, uint64_t bytes, uint64_t baseWord)
+{
+	uint64_t numWords = bytes / 8;
+	uint64_t sum = 0;
+
+	#pragma omp parallel for schedule(static) reduction(+:sum)
+	for (uint64_t k = 0; k < numWords; k++)
+	{
+		uint64_t w;
+		memcpy(&w, data + 8 * k, 8);
+		sum += w * (2 * (baseWord + k) + 1);
+	}
+
+	if (bytes % 8)
+	{
+		uint64_t w = 0;
+		memcpy(&w, data + 8 * numWords, bytes % 8);
+		sum += w * (2 * (baseWord + numWords) + 1);
+	}
+	return sum;
+}
+
+static bool writeSection(FILE *fp, const void *data, uint64_t bytes, uint64_t offset)
+{
+	static const char zeros[BINCACHE_ALIGN] = {};
+	long pos = ftell(fp);
+	if (pos < 0 || (uint64_t) pos > offset)
+	{
+		return false;
+	}
+	if (fwrite(zeros, 1, offset - pos, fp) != offset - pos)
+	{
+		return false;
+	}
+	return fwrite(data, 1, bytes, fp) == bytes;
+}
+
+bool isBinaryMatrix(const std::string &strFilename)
+{
+	char magic[8];
+	FILE *fp = fopen(strFilename.c_str(), "rb");
+	if (fp == NULL)
+	{
+		return false;
+	}
+	bool bIsBinary = fread(magic, 1, 8, fp) == 8 && memcmp(magic, BINCACHE_MAGIC, 8) == 0;
+	fclose(fp);
+	return bIsBinary;
+}
+
+bool mapBinaryMatrix(const std::string &strFilename, const struct stat *source, ooo_input *tInput)
+{
+	int fd = open(strFilename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat st;
+	ooo_bincache_header header;
+	if (fstat(fd, &st) != 0 || pread(fd, &header, sizeof(header), 0) != sizeof(header))
+	{
+		close(fd);
+		return false;
+	}
+
+	// validate the header before trusting any offset
+	if (memcmp(header.magic, BINCACHE_MAGIC, 8) != 0 ||
+		header.version != BINCACHE_VERSION ||
+		header.headerSize != sizeof(header) ||
+		header.fileSize != (uint64_t) st.st_size ||
+		header.numRows < 0 || header.numCols < 0 || header.numNonzeros < 0 ||
+		header.numRows > std::numeric_limits<int>::max() ||
+		header.numCols > std::numeric_limits<int>::max() ||
+		header.numNonzeros > st.st_size / (int64_t) (sizeof(int) + sizeof(double)) ||
+		header.rowOffset < sizeof(header) ||
+		header.colOffset < header.rowOffset + sizeof(int64_t) * (header.numRows + 1) ||
+		header.valOffset < header.colOffset + sizeof(int) * header.numNonzeros ||
+		header.fileSize < header.valOffset + sizeof(double) * header.numNonzeros)
+	{
+		std::cerr << "WARNING: ignoring invalid binary matrix " << strFilename << std::endl;
+		close(fd);
+		return false;
+	}
+
+	// a cache is stale once its text source changed
+	if (source != NULL &&
+		(header.sourceSize != (uint64_t) source->st_size || header.sourceMtime != modificationTime(source)))
+	{
+		close(fd);
+		return false;
+	}
+
+	// private mapping: pages are loaded on demand, writes stay process-local
+	char *data = (char*) mmap(NULL, header.fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+
+	if (checksum(data + header.rowOffset, header.fileSize - header.rowOffset, 0) != header.checksum)
+	{
+		std::cerr << "WARNING: checksum mismatch in binary matrix " << strFilename << std::endl;
+		munmap(data, header.fileSize);
+		return false;
+	}
+
+	// the checksum only proves the data is what was written, the kernels also need it to match the header
+	const int64_t *row = (const int64_t*) (data + header.rowOffset);
+	const int *col = (const int*) (data + header.colOffset);
+	bool bConsistent = row[0] == 0 && row[header.numRows] == header.numNonzeros;
+	#pragma omp parallel for schedule(static) reduction(&&:bConsistent)
+	for (int64_t i = 0; i < header.numRows; i++)
+	{
+		bConsistent = bConsistent && row[i] <= row[i+1];
+	}
+	#pragma omp parallel for schedule(static) reduction(&&:bConsistent)
+	for (int64_t nz = 0; nz < header.numNonzeros; nz++)
+	{
+		bConsistent = bConsistent && col[nz] >= 0 && col[nz] < header.numCols;
+	}
+	if (! bConsistent)
+	{
+		std::cerr << "WARNING: row pointers or columns of binary matrix " << strFilename << " do not match its header" << std::endl;
+		munmap(data, header.fileSize);
+		return false;
+	}
+
+	tInput->tMemory.adoptMapping(data, header.fileSize);
+	tInput->stNumRows = header.numRows;
+	tInput->stNumNonzeros = header.numNonzeros;
+	tInput->row = (int64_t*) (data + header.rowOffset);
+	tInput->col = (int*) (data + header.colOffset);
+	tInput->val = (double*) (data + header.valOffset);
+
+	std::cout << "mapped binary matrix from " << strFilename << std::endl;
+	return true;
+}
+
+bool writeBinaryMatrix(const std::string &strFilename, const struct stat *source, int iNumCols, ooo_input *tInput)
+{
+	uint64_t rowBytes = sizeof(int64_t) * ((uint64_t) tInput->stNumRows + 1);
+	uint64_t colBytes = sizeof(int) * (uint64_t) tInput->stNumNonzeros;
+	uint64_t valBytes = sizeof(double) * (uint64_t) tInput->stNumNonzeros;
+
+	ooo_bincache_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BINCACHE_MAGIC, 8);
+	header.version = BINCACHE_VERSION;
+	header.headerSize = sizeof(header);
+	header.numRows = tInput->stNumRows;
+	header.numCols = iNumCols;
+	header.numNonzeros = tInput->stNumNonzeros;
+	header.rowOffset = alignUp(sizeof(header));
+	header.colOffset = alignUp(header.rowOffset + rowBytes);
+	header.valOffset = alignUp(header.colOffset + colBytes);
+	header.fileSize = header.valOffset + valBytes;
+	header.sourceSize = (source != NULL) ? source->st_size : 0;
+	header.sourceMtime = (source != NULL) ? modificationTime(source) : 0;
+	header.checksum =
+		checksum((const char*) tInput->row, rowBytes, 0) +
+		checksum((const char*) tInput->col, colBytes, (header.colOffset - header.rowOffset) / 8) +
+		checksum((const char*) tInput->val, valBytes, (header.valOffset - header.rowOffset) / 8);
+
+	// write to a temporary file first, so readers never see a partial cache
+	// per process, concurrent rank processes may write the same cache
+	std::string strTmp = strFilename + ".tmp." + std::to_string((int) getpid());
+	FILE *fp = fopen(strTmp.c_str(), "wb");
+	if (fp == NULL)
+	{
+		std::cerr << "WARNING: could not write binary matrix cache " << strFilename << std::endl;
+		return false;
+	}
+
+	bool bOk = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+		writeSection(fp, tInput->row, rowBytes, header.rowOffset) &&
+		writeSection(fp, tInput->col, colBytes, header.colOffset) &&
+		writeSection(fp, tInput->val, valBytes, header.valOffset);
+	bOk = (fclose(fp) == 0) && bOk;
+
+	if (! bOk || rename(strTmp.c_str(), strFilename.c_str()) != 0)
+	{
+		std::cerr << "WARNING: could not write binary matrix cache " << strFilename << std::endl;
+		unlink(strTmp.c_str());
+		return false;
+	}
+
+	std::cout << "wrote binary matrix cache " << strFilename << std::endl;
+	return true;
+}
@@ -0,0 +1,47 @@
+#ifndef INC_OOOBINCACHE_H
+#define INC_OOOBINCACHE_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <string>
+
+#include "ooo_cmdline.h"
+
+#define BINCACHE_MAGIC "OOOCSR\r\n"
+#define BINCACHE_VERSION 2
+// sections start at page boundaries so they can be mapped directly
+#define BINCACHE_ALIGN 4096
+
+/**
+ * Header of the binary CSR container, followed by the row (64 bit), column
+ * (32 bit) and value sections at the given (aligned) byte offsets.
+ */
+struct ooo_bincache_header
+{
+	char			magic[8];
+	uint32_t		version;
+	uint32_t		headerSize;
+	int64_t			numRows;
+	int64_t			numCols;
+	int64_t			numNonzeros;
+	uint64_t		rowOffset;
+	uint64_t		colOffset;
+	uint64_t		valOffset;
+	uint64_t		fileSize;
+	uint64_t		sourceSize;		// size and mtime of the text matrix the cache was built from
+	int64_t			sourceMtime;	// in nanoseconds
+	uint64_t		checksum;		// over all bytes from rowOffset to fileSize
+};
+
+bool isBinaryMatrix(const std::string &strFilename);
+
+/**
+ * Maps a binary matrix into tInput, whose tMemory owns the mapping. Rejects
+ * files whose header, checksum, row pointers or columns do not match, and
+ * caches older than their text source.
+ */
+bool mapBinaryMatrix(const std::string &strFilename, const struct stat *source, ooo_input *tInput);
+bool writeBinaryMatrix(const std::string &strFilename, const struct stat *source, int iNumCols, ooo_input *tInput);
+
+#endif
@@ -1,15 +1,18 @@
 #include "ooo_cmdline.h"
+#include "ooo_bincache.h"
+#include "ooo_parser.h"
+#include "ooo_generator.h"
 #include <math.h>
 #include <algorithm>
 #include <vector>
 
-#define RES_SMALL 229.045069
-#define RES_LARGE 469.041944
+static const char *mformatNames[] = { "csr", "ep", "sell", "csr-rl", "csr-merge", "csr-cmp", "csr-sym", "csr-panel", "auto", "bcsr" };
+static const char *reorderNames[] = { "none", "rcm", "part", "colour" };
+static const char *precondNames[] = { "none", "jacobi", "ilu0" };
+static const char *xVectorNames[] = { "ones", "random", "file" };
+static const char *transposeNames[] = { "no", "auto", "buffers", "csc" };
 
-#define SIZE_SMALL 59319
-#define SIZE_LARGE 493039
-
-void print_performance_results(ooo_options *tOptions, double t1, double t2, timespan *timings, ooo_input *tInput)
+void print_performance_results(ooo_options *tOptions, double t1, double t2, timespan *timings, ooo_input *tInput, timespan *precondTimings, ooo_roofline *tRoofline)
 {
 	// compute metrics
 	double dTotalExperimentTime = t2 - t1;
@@ -25,7 +28,7 @@ void print_performance_results(ooo_options *tOptions, double t1, double t2, time
 	}
 	dMeanTime /= tOptions->iNumRepetitions;
 
-	double temp = (double)tInput->stNumNonzeros / 1e6 * 2.; // number of instructions in MFlop
+	double temp = (double)tInput->stNumNonzeros / 1e6 * 2. * tOptions->iNumVectors; // number of instructions in MFlop
 	double mTotalFlops = tOptions->iNumRepetitions / dTotalExperimentTime * temp;
 	double mMinFlops = temp / dMaxTime;
 	double mMaxFlops = temp / dMinTime;
@@ -36,7 +39,17 @@ void print_performance_results(ooo_options *tOptions, double t1, double t2, time
 	std::cout << "Configuration              " << std::endl;
 	std::cout << "Number of Threads:         " << tOptions->iNumThreads << std::endl;
 	std::cout << "Number of Repetitions:     " << tOptions->iNumRepetitions << std::endl;
+	std::cout << "Number of Vectors:         " << tOptions->iNumVectors << std::endl;
 	std::cout << "Input filename:            " << tOptions->strFilename << std::endl;
+	std::cout << "Matrix format:             " << mformatNames[tOptions->mformat] << std::endl;
+	std::cout << "Reordering:                " << reorderNames[tOptions->reorder] << std::endl;
+	std::cout << "x vector:                  " << (tOptions->xVector == XVECTOR_FILE ? tOptions->strXFilename : xVectorNames[tOptions->xVector]) << std::endl;
+	std::cout << "Replicated x:              " << (tOptions->replicateX ? "yes" : "no") << std::endl;
+	std::cout << "NUMA domains:              " << (tOptions->numaDomains ? "yes" : "no") << std::endl;
+	std::cout << "Distributed ranks:         " << tOptions->iNumRanks << std::endl;
+	std::cout << "Transpose:                 " << transposeNames[tOptions->transpose] << std::endl;
+	std::cout << "Persistent thread team:    " << (tOptions->persistent ? "yes" : "no") << std::endl;
+	std::cout << "Preconditioner:            " << precondNames[tOptions->precond] << std::endl;
 	std::cout << std::endl;
 	std::cout << "Time measurements          " << std::endl;
 	std::cout << "Total experiment time:     " << dTotalExperimentTime << std::endl;
@@ -49,6 +62,41 @@ void print_performance_results(ooo_options *tOptions, double t1, double t2, time
 	std::cout << "Minimum MFlops/s:          " << mMinFlops << std::endl;
 	std::cout << "Maximum MFlops/s:          " << mMaxFlops << std::endl;
 	std::cout << "Arithm. Mean MFlops/s:     " << mMeanFlops << std::endl;
+	if (precondTimings != NULL)
+	{
+		double dMinApply = numeric_limits<double>::max();
+		double dMeanApply = 0.0;
+		for (int i = 0; i < tOptions->iNumRepetitions; i++)
+		{
+			double d = precondTimings[i].dEnd - precondTimings[i].dBegin;
+			dMinApply = std::min<double>(dMinApply, d);
+			dMeanApply += d;
+		}
+		dMeanApply /= tOptions->iNumRepetitions;
+		std::cout << "Minimum apply time:        " << dMinApply << std::endl;
+		std::cout << "Arithm. Mean apply time:   " << dMeanApply << std::endl;
+	}
+	if (tRoofline != NULL)
+	{
+		// roofline data point from the mean kernel time
+		double dBytes = tRoofline->dMatrixBytes + tRoofline->dXBytes + tRoofline->dYBytes;
+		double dBalance = dBytes / (temp * 1e6);
+		double dBandwidth = dBytes / dMeanTime / 1e9;
+		std::cout << std::endl;
+		std::cout << "Roofline                   " << std::endl;
+		std::cout << "Matrix MB per repetition:  " << tRoofline->dMatrixBytes / 1e6 << std::endl;
+		std::cout << "x MB per repetition:       " << tRoofline->dXBytes / 1e6 << std::endl;
+		std::cout << "y MB per repetition:       " << tRoofline->dYBytes / 1e6 << std::endl;
+		std::cout << "Code balance (bytes/flop): " << dBalance << std::endl;
+		std::cout << "Achieved GB/s:             " << dBandwidth << std::endl;
+		std::cout << "Working set fits the LLC:  " << (dBytes <= tRoofline->dCacheBytes ? "yes" : "no") << std::endl;
+		if (tRoofline->dStreamBandwidth > 0.0)
+		{
+			std::cout << "STREAM triad GB/s:         " << tRoofline->dStreamBandwidth << std::endl;
+			std::cout << "Percent of STREAM triad:   " << 100.0 * dBandwidth / tRoofline->dStreamBandwidth << std::endl;
+			std::cout << "Roofline limit MFlops/s:   " << tRoofline->dStreamBandwidth * 1e3 / dBalance << std::endl;
+		}
+	}
 	std::cout << std::endl;
 }
 
@@ -62,13 +110,55 @@ bool parseCmdLine(ooo_options *options, int argc, char* argv[])
 	opt->addUsage("");
 	opt->addUsage(" -h  --help:                 Prints this help text.");
 	opt->addUsage(" -t  --threads num:          Number of threads to be used.");
-	opt->addUsage(" -f  --filename name:        Use input file (default: none).");
+	opt->addUsage(" -f  --filename name:        Use input file: DROPS or Matrix Market text, or binary matrix (default: none).");
+	opt->addUsage("     --no-cache:             Neither read nor write the binary matrix cache <filename>.bin.");
+	opt->addUsage("     --stream:               Measure the STREAM triad bandwidth for the roofline report (default: off).");
+	opt->addUsage("     --no-verify:            Skip the element-wise check of y against a compensated reference SpMV.");
+	opt->addUsage("     --verify-tol num:       Relative tolerance of the check (default: rounding error bound of each row).");
 	opt->addUsage(" -r  --repetitions num:      Number of repetitions (default: 10).");
-	opt->addUsage(" -m  --matrix-format csr|ep: Sparse matrix format (Compressed sparse row(csr), Ellpack(ep)) (default: csr).");
+	opt->addUsage(" -b  --block-vectors num:    Multiply num interleaved vectors x * (v + 1), v < num, at once, 1..64, csr only (default: 1).");
+	opt->addUsage(" -m  --matrix-format csr|ep|sell|csr-rl|csr-merge|csr-cmp|csr-sym|csr-panel|bcsr|auto: Sparse matrix format (Compressed sparse row(csr),");
+	opt->addUsage("                             Ellpack(ep), SELL-C-sigma(sell), CSR with row-length specialised kernels(csr-rl), merge-path CSR for");
+	opt->addUsage("                             irregular rows(csr-merge), CSR storing columns as 16 bit offsets from the smallest column of each");
+	opt->addUsage("                             row block and values as float(csr-cmp), upper triangle of a symmetric matrix(csr-sym), CSR split into");
+	opt->addUsage("                             column panels(csr-panel), CSR of small dense blocks(bcsr),");
+	opt->addUsage("                             or the fastest of short trials of the formats that suit the matrix statistics, and its thread");
+	opt->addUsage("                             count(auto)) (default: csr).");
+	opt->addUsage("     --bcsr-block RxC:       Block size of bcsr, 1x1 to 4x4 (default: least traffic at the estimated fill ratio).");
+	opt->addUsage("     --tune-cache name:      File the auto decisions are cached in, per matrix fingerprint and host (default: spmxv.tune).");
+	opt->addUsage("     --no-tune-cache:        Always run the auto trials and do not record the decision.");
+	opt->addUsage("     --value-precision double|auto|float: Value storage of csr-cmp, auto uses float only where exact (default: auto).");
+	opt->addUsage("     --transpose auto|buffers|csc: Compute y = A^T x on csr, scattering into per-thread y buffers(buffers), or with");
+	opt->addUsage("                             a transposed copy cached as <filename>.T.bin(csc), auto takes csc if it fits the budget.");
+	opt->addUsage("     --transpose-budget MB:  Memory the transposed copy may take under auto (default: half the free memory).");
+	opt->addUsage("     --persistent:           Run all repetitions of csr in one thread team, separated by a spinning barrier.");
+	opt->addUsage("     --panel-cols num:       Columns per panel of csr-panel (default: x segment of half the L2 cache).");
+	opt->addUsage("     --solver none|cg|pipecg|bicgstab: Solve A x = A 1 from x = 0 with CG, pipelined CG or BiCGStab on csr and report");
+	opt->addUsage("                             the time to tolerance instead of benchmarking the SpMV (default: none).");
+	opt->addUsage("     --tol num:              Relative residual the solver has to reach (default: 1e-8).");
+	opt->addUsage("     --max-iter num:         Maximum number of solver iterations (default: 10000).");
+	opt->addUsage("     --precond none|jacobi|ilu0: Preconditioner of the solvers, also timed per apply in the SpMV benchmark (default: none).");
+	opt->addUsage("     --x-vector ones|random|name: Input vector x, all ones, uniform random in [0, 1) or read from a file with one");
+	opt->addUsage("                             value per row (default: ones).");
+	opt->addUsage("     --replicate-x:          Keep a copy of x on every NUMA node and let each thread gather from its local one, csr only.");
+	opt->addUsage("     --numa-domains:         Give every NUMA node its own slice of rows with node-local matrix, x and y, csr only.");
+	opt->addUsage("     --ranks num:            Split the rows of csr across num processes that exchange the x halo, over shared memory");
+	opt->addUsage("                             on this machine, or over MPI if built with MPI=1 and started with mpirun (default: 1).");
+	opt->addUsage("     --reorder none|rcm|part|colour: Reorder rows and columns after loading, reverse Cuthill-McKee(rcm), recursive graph");
+	opt->addUsage("                             bisection(part) or multicolouring for parallel ILU(0) solves(colour) (default: none).");
+	opt->addUsage("     --sell-c num:           Chunk size C of SELL-C-sigma, one of 4, 8, 16, 32 (default: 8).");
+	opt->addUsage("     --sell-sigma num:       Sorting window sigma of SELL-C-sigma (default: 256).");
 	opt->addUsage(" -c  --create-matrix:        Create new sparse matrix. Cannot be used with filename option.");
 	opt->addUsage(" -n  --num-rows num:         Number of rows (and columns) in created matrix (default: 1000) (only works with -c).");
-	opt->addUsage(" -q  --shift-prob num:       Probability of nonzero moves in created matrix (default: 0.0) (only works with -c).");
-	opt->addUsage(" -z  --num-row-nz num:       Number of nonzeros per row in created matrix (default: 5) (only works with -c).");
+	opt->addUsage(" -q  --shift-prob num:       Probability of nonzero moves in created diag matrix (default: 0.0) (only works with -c).");
+	opt->addUsage(" -z  --num-row-nz num:       Number of nonzeros per row in created matrix, mean for powerlaw, 9/27 selects the");
+	opt->addUsage("                             full 2D/3D stencil (default: 5) (only works with -c).");
+	opt->addUsage("     --structure diag|band|block|powerlaw|stencil2d|stencil3d: Structure of the created matrix, entries around the");
+	opt->addUsage("                             diagonal moved with probability q(diag), random within a band(band) or diagonal");
+	opt->addUsage("                             blocks(block), Pareto distributed row lengths(powerlaw), Laplacian on a square or cube");
+	opt->addUsage("                             grid(stencil2d, stencil3d) (default: diag) (only works with -c).");
+	opt->addUsage("     --bandwidth num:        Max. distance from the diagonal of a created band matrix (default: 4 * nonzeros per row).");
+	opt->addUsage("     --block-size num:       Rows per diagonal block of a created block matrix (default: 64).");
 	opt->addUsage(" -w  --write-mat:            Write created matrix to file input-matrix/testMat.txt (only works with -c).");
 	opt->addUsage("");
 	opt->addUsage("");
@@ -78,13 +168,40 @@ bool parseCmdLine(ooo_options *options, int argc, char* argv[])
 	opt->setFlag("help", 'h');
 	opt->setOption("threads", 't');
 	opt->setOption("filename", 'f');
+	opt->setFlag("no-cache");
+	opt->setFlag("stream");
+	opt->setFlag("no-verify");
+	opt->setOption("verify-tol");
 	opt->setOption("repetitions", 'r');
+	opt->setOption("block-vectors", 'b');
 	opt->setOption("matrix-format", 'm');
+	opt->setOption("tune-cache");
+	opt->setFlag("no-tune-cache");
+	opt->setOption("value-precision");
+	opt->setOption("transpose");
+	opt->setOption("transpose-budget");
+	opt->setFlag("persistent");
+	opt->setOption("panel-cols");
+	opt->setOption("bcsr-block");
+	opt->setOption("solver");
+	opt->setOption("tol");
+	opt->setOption("max-iter");
+	opt->setOption("precond");
+	opt->setOption("x-vector");
+	opt->setFlag("replicate-x");
+	opt->setFlag("numa-domains");
+	opt->setOption("ranks");
+	opt->setOption("reorder");
+	opt->setOption("sell-c");
+	opt->setOption("sell-sigma");
 	opt->setFlag("create-matrix", 'c');
 	opt->setOption("num-rows", 'n');
 	opt->setOption("shift-prob", 'q');
 	opt->setOption("num-row-nz", 'z');
 	opt->setFlag("write-mat", 'w');
+	opt->setOption("structure");
+	opt->setOption("bandwidth");
+	opt->setOption("block-size");
 	
 
 	// process commandline
@@ -126,6 +243,7 @@ bool parseCmdLine(ooo_options *options, int argc, char* argv[])
 			std::cout << "filename option set, ignoring flags -c, -n, -q, -z, -w\n";
 		}
 		options->createMat = false;
+		options->useCache = ! opt->getFlag("no-cache");
 	}
 	else
 	{
@@ -159,6 +277,52 @@ bool parseCmdLine(ooo_options *options, int argc, char* argv[])
 				options->nzPerRow = 5;
 			}
 			options->writeMat = opt->getFlag('w');
+			if (options->nRows <= 0 || options->nzPerRow <= 0 || options->nzPerRow > options->nRows)
+			{
+				std::cerr << "ERROR: created matrix needs a positive number of rows and 1..rows nonzeros per row" << std::endl;
+				delete opt;
+				return false;
+			}
+
+			options->structure = STRUCTURE_DIAG;
+			if(opt->getValue("structure") != NULL)
+			{
+				char *strStructure = opt->getValue("structure");
+				if(strcmp(strStructure, "diag") == 0) options->structure = STRUCTURE_DIAG;
+				else if(strcmp(strStructure, "band") == 0) options->structure = STRUCTURE_BAND;
+				else if(strcmp(strStructure, "block") == 0) options->structure = STRUCTURE_BLOCK;
+				else if(strcmp(strStructure, "powerlaw") == 0) options->structure = STRUCTURE_POWERLAW;
+				else if(strcmp(strStructure, "stencil2d") == 0) options->structure = STRUCTURE_STENCIL2D;
+				else if(strcmp(strStructure, "stencil3d") == 0) options->structure = STRUCTURE_STENCIL3D;
+				else
+				{
+					std::cerr << "ERROR: unrecognized matrix structure: " << strStructure << std::endl;
+					delete opt;
+					return false;
+				}
+			}
+			options->bandwidth = 0;
+			if(opt->getValue("bandwidth") != NULL)
+			{
+				options->bandwidth = atoi(opt->getValue("bandwidth"));
+				if(options->bandwidth <= 0)
+				{
+					std::cerr << "ERROR: bandwidth must be positive" << std::endl;
+					delete opt;
+					return false;
+				}
+			}
+			options->blockSize = 64;
+			if(opt->getValue("block-size") != NULL)
+			{
+				options->blockSize = atoi(opt->getValue("block-size"));
+				if(options->blockSize <= 0)
+				{
+					std::cerr << "ERROR: block size must be positive" << std::endl;
+					delete opt;
+					return false;
+				}
+			}
 		}
 		else
 		{
@@ -189,6 +353,14 @@ bool parseCmdLine(ooo_options *options, int argc, char* argv[])
 		char *strMFormat = opt->getValue('m');
 		if(strcmp(strMFormat, "csr") == 0) options->mformat = MFORMAT_CSR;
 		else if(strcmp(strMFormat, "ep") == 0) options->mformat = MFORMAT_ELLPACK;
+		else if(strcmp(strMFormat, "sell") == 0) options->mformat = MFORMAT_SELL;
+		else if(strcmp(strMFormat, "csr-rl") == 0) options->mformat = MFORMAT_CSR_RL;
+		else if(strcmp(strMFormat, "csr-merge") == 0) options->mformat = MFORMAT_CSR_MERGE;
+		else if(strcmp(strMFormat, "csr-cmp") == 0) options->mformat = MFORMAT_CSR_CMP;
+		else if(strcmp(strMFormat, "csr-sym") == 0) options->mformat = MFORMAT_CSR_SYM;
+		else if(strcmp(strMFormat, "csr-panel") == 0) options->mformat = MFORMAT_CSR_PANEL;
+		else if(strcmp(strMFormat, "auto") == 0) options->mformat = MFORMAT_AUTO;
+		else if(strcmp(strMFormat, "bcsr") == 0) options->mformat = MFORMAT_BCSR;
 
 		else
 		{
@@ -200,6 +372,273 @@ bool parseCmdLine(ooo_options *options, int argc, char* argv[])
 	{
 		options->mformat = MFORMAT_CSR;
 	}
+	options->strTuneCache = "spmxv.tune";
+	if(opt->getValue("tune-cache") != NULL)
+	{
+		options->strTuneCache = opt->getValue("tune-cache");
+	}
+	if(opt->getFlag("no-tune-cache"))
+	{
+		options->strTuneCache = "";
+	}
+	options->iNumVectors = 1;
+	if (opt->getValue("block-vectors") != NULL || opt->getValue('b') != NULL)
+	{
+		options->iNumVectors = atoi(opt->getValue('b'));
+		if (options->iNumVectors < 1 || options->iNumVectors > 64)
+		{
+			std::cerr << "ERROR: number of block vectors must be within 1..64" << std::endl;
+			delete opt;
+			return false;
+		}
+		if (options->iNumVectors > 1 && options->mformat != MFORMAT_CSR)
+		{
+			std::cerr << "ERROR: block vectors are only supported with -m csr" << std::endl;
+			delete opt;
+			return false;
+		}
+	}
+	options->valuePrecision = VALUE_AUTO;
+	if(opt->getValue("value-precision") != NULL)
+	{
+		char *strPrecision = opt->getValue("value-precision");
+		if(strcmp(strPrecision, "double") == 0) options->valuePrecision = VALUE_DOUBLE;
+		else if(strcmp(strPrecision, "auto") == 0) options->valuePrecision = VALUE_AUTO;
+		else if(strcmp(strPrecision, "float") == 0) options->valuePrecision = VALUE_FLOAT;
+		else
+		{
+			std::cerr << "ERROR: unrecognized value precision: " << strPrecision << std::endl;
+			delete opt;
+			return false;
+		}
+	}
+	options->stream = opt->getFlag("stream");
+	options->verify = ! opt->getFlag("no-verify");
+	options->dVerifyTolerance = 0.0;
+	if(opt->getValue("verify-tol") != NULL)
+	{
+		options->dVerifyTolerance = atof(opt->getValue("verify-tol"));
+		if(! (options->dVerifyTolerance > 0.0))
+		{
+			std::cerr << "ERROR: verification tolerance must be positive" << std::endl;
+			delete opt;
+			return false;
+		}
+	}
+	options->persistent = opt->getFlag("persistent");
+	if (options->persistent && (options->mformat != MFORMAT_CSR || options->iNumVectors > 1))
+	{
+		std::cerr << "ERROR: the persistent thread team is only supported with -m csr and a single vector" << std::endl;
+		delete opt;
+		return false;
+	}
+	options->panelCols = 0;
+	if(opt->getValue("panel-cols") != NULL)
+	{
+		options->panelCols = atoi(opt->getValue("panel-cols"));
+		if(options->panelCols <= 0)
+		{
+			std::cerr << "ERROR: panel width must be positive" << std::endl;
+			delete opt;
+			return false;
+		}
+	}
+	options->bcsrRows = 0;
+	options->bcsrCols = 0;
+	if(opt->getValue("bcsr-block") != NULL)
+	{
+		char *strBlock = opt->getValue("bcsr-block");
+		if(sscanf(strBlock, "%dx%d", &options->bcsrRows, &options->bcsrCols) != 2 ||
+			options->bcsrRows < 1 || options->bcsrRows > 4 || options->bcsrCols < 1 || options->bcsrCols > 4)
+		{
+			std::cerr << "ERROR: BCSR block size must be RxC with R and C within 1..4: " << strBlock << std::endl;
+			delete opt;
+			return false;
+		}
+	}
+	options->solver = SOLVER_NONE;
+	if(opt->getValue("solver") != NULL)
+	{
+		char *strSolver = opt->getValue("solver");
+		if(strcmp(strSolver, "none") == 0) options->solver = SOLVER_NONE;
+		else if(strcmp(strSolver, "cg") == 0) options->solver = SOLVER_CG;
+		else if(strcmp(strSolver, "pipecg") == 0) options->solver = SOLVER_PIPECG;
+		else if(strcmp(strSolver, "bicgstab") == 0) options->solver = SOLVER_BICGSTAB;
+		else
+		{
+			std::cerr << "ERROR: unrecognized solver: " << strSolver << std::endl;
+			delete opt;
+			return false;
+		}
+		if (options->mformat != MFORMAT_CSR || options->iNumVectors > 1 || options->persistent)
+		{
+			std::cerr << "ERROR: the solvers only support -m csr with a single vector" << std::endl;
+			delete opt;
+			return false;
+		}
+	}
+	options->dTolerance = 1e-8;
+	if(opt->getValue("tol") != NULL)
+	{
+		options->dTolerance = atof(opt->getValue("tol"));
+		if(! (options->dTolerance > 0.0))
+		{
+			std::cerr << "ERROR: solver tolerance must be positive" << std::endl;
+			delete opt;
+			return false;
+		}
+	}
+	options->iMaxIterations = 10000;
+	if(opt->getValue("max-iter") != NULL)
+	{
+		options->iMaxIterations = atoi(opt->getValue("max-iter"));
+		if(options->iMaxIterations <= 0)
+		{
+			std::cerr << "ERROR: maximum number of iterations must be positive" << std::endl;
+			delete opt;
+			return false;
+		}
+	}
+	options->precond = PRECOND_NONE;
+	if(opt->getValue("precond") != NULL)
+	{
+		char *strPrecond = opt->getValue("precond");
+		if(strcmp(strPrecond, "none") == 0) options->precond = PRECOND_NONE;
+		else if(strcmp(strPrecond, "jacobi") == 0) options->precond = PRECOND_JACOBI;
+		else if(strcmp(strPrecond, "ilu0") == 0) options->precond = PRECOND_ILU0;
+		else
+		{
+			std::cerr << "ERROR: unrecognized preconditioner: " << strPrecond << std::endl;
+			delete opt;
+			return false;
+		}
+	}
+	if (options->precond != PRECOND_NONE && options->iNumVectors > 1)
+	{
+		std::cerr << "ERROR: the preconditioner is only applied to a single vector" << std::endl;
+		delete opt;
+		return false;
+	}
+	options->xVector = XVECTOR_ONES;
+	if(opt->getValue("x-vector") != NULL)
+	{
+		char *strXVector = opt->getValue("x-vector");
+		if(strcmp(strXVector, "ones") == 0) options->xVector = XVECTOR_ONES;
+		else if(strcmp(strXVector, "random") == 0) options->xVector = XVECTOR_RANDOM;
+		else
+		{
+			options->xVector = XVECTOR_FILE;
+			options->strXFilename = strXVector;
+		}
+		if (options->xVector != XVECTOR_ONES && options->solver != SOLVER_NONE)
+		{
+			std::cerr << "ERROR: the solvers use the exact solution x = 1, --x-vector does not apply" << std::endl;
+			delete opt;
+			return false;
+		}
+	}
+	options->replicateX = opt->getFlag("replicate-x");
+	if (options->replicateX && (options->mformat != MFORMAT_CSR || options->solver != SOLVER_NONE))
+	{
+		std::cerr << "ERROR: x replication is only supported by the -m csr SpMV benchmark" << std::endl;
+		delete opt;
+		return false;
+	}
+	options->numaDomains = opt->getFlag("numa-domains");
+	if (options->numaDomains && (options->mformat != MFORMAT_CSR || options->iNumVectors > 1 || options->persistent ||
+		options->replicateX || options->solver != SOLVER_NONE))
+	{
+		std::cerr << "ERROR: NUMA domains are only supported by the -m csr SpMV benchmark with a single vector, they keep their own x" << std::endl;
+		delete opt;
+		return false;
+	}
+	options->iNumRanks = 1;
+	if(opt->getValue("ranks") != NULL)
+	{
+		options->iNumRanks = atoi(opt->getValue("ranks"));
+		if(options->iNumRanks <= 0)
+		{
+			std::cerr << "ERROR: number of ranks must be positive" << std::endl;
+			delete opt;
+			return false;
+		}
+		if (options->iNumRanks > 1 && (options->mformat != MFORMAT_CSR || options->iNumVectors > 1 || options->persistent ||
+			options->replicateX || options->numaDomains || options->solver != SOLVER_NONE || options->precond != PRECOND_NONE))
+		{
+			std::cerr << "ERROR: distributed ranks are only supported by the -m csr SpMV benchmark with a single vector" << std::endl;
+			delete opt;
+			return false;
+		}
+	}
+	options->transpose = TRANSPOSE_NONE;
+	if(opt->getValue("transpose") != NULL)
+	{
+		char *strTranspose = opt->getValue("transpose");
+		if(strcmp(strTranspose, "auto") == 0) options->transpose = TRANSPOSE_AUTO;
+		else if(strcmp(strTranspose, "buffers") == 0) options->transpose = TRANSPOSE_BUFFERS;
+		else if(strcmp(strTranspose, "csc") == 0) options->transpose = TRANSPOSE_CSC;
+		else
+		{
+			std::cerr << "ERROR: unrecognized transpose method: " << strTranspose << std::endl;
+			delete opt;
+			return false;
+		}
+		if (options->mformat != MFORMAT_CSR || options->iNumVectors > 1 || options->persistent || options->replicateX ||
+			options->numaDomains || options->iNumRanks > 1 || options->solver != SOLVER_NONE || options->precond != PRECOND_NONE)
+		{
+			std::cerr << "ERROR: the transpose is only supported by the -m csr SpMV benchmark with a single vector" << std::endl;
+			delete opt;
+			return false;
+		}
+	}
+	options->dTransposeBudget = 0.0;
+	if(opt->getValue("transpose-budget") != NULL)
+	{
+		options->dTransposeBudget = atof(opt->getValue("transpose-budget")) * 1e6;
+		if(options->dTransposeBudget <= 0.0)
+		{
+			std::cerr << "ERROR: transpose budget must be positive" << std::endl;
+			delete opt;
+			return false;
+		}
+	}
+	options->reorder = REORDER_NONE;
+	if(opt->getValue("reorder") != NULL)
+	{
+		char *strReorder = opt->getValue("reorder");
+		if(strcmp(strReorder, "none") == 0) options->reorder = REORDER_NONE;
+		else if(strcmp(strReorder, "rcm") == 0) options->reorder = REORDER_RCM;
+		else if(strcmp(strReorder, "part") == 0) options->reorder = REORDER_PART;
+		else if(strcmp(strReorder, "colour") == 0) options->reorder = REORDER_COLOUR;
+		else
+		{
+			std::cerr << "ERROR: unrecognized reordering: " << strReorder << std::endl;
+			delete opt;
+			return false;
+		}
+	}
+	options->sellC = 8;
+	if(opt->getValue("sell-c") != NULL)
+	{
+		options->sellC = atoi(opt->getValue("sell-c"));
+		if(options->sellC != 4 && options->sellC != 8 && options->sellC != 16 && options->sellC != 32)
+		{
+			std::cerr << "ERROR: SELL chunk size must be one of 4, 8, 16, 32" << std::endl;
+			delete opt;
+			return false;
+		}
+	}
+	options->sellSigma = 256;
+	if(opt->getValue("sell-sigma") != NULL)
+	{
+		options->sellSigma = atoi(opt->getValue("sell-sigma"));
+		if(options->sellSigma <= 0)
+		{
+			std::cerr << "ERROR: SELL sorting window must be positive" << std::endl;
+			delete opt;
+			return false;
+		}
+	}
 
 	// done
 	delete opt;
@@ -216,11 +655,33 @@ bool loadInputFile_4SMXV(ooo_options *tOptions, ooo_input *tInput)
 		std::cout << std::endl;
 		return false;
 	}
+	fdat.close();
 
-	int iDummy;
-	load_drops_matlab_matrix<double, int>(tOptions->strFilename.c_str(),
-		tInput->row, tInput->col, tInput->val, tInput->stNumRows, iDummy,
-		tInput->stNumNonzeros);
+	// binary matrices are mapped directly
+	if (isBinaryMatrix(tOptions->strFilename))
+	{
+		return mapBinaryMatrix(tOptions->strFilename, NULL, tInput);
+	}
+
+	// otherwise prefer an up-to-date cache of the text matrix
+	struct stat source;
+	std::string strCache = tOptions->strFilename + ".bin";
+	bool bHaveSource = stat(tOptions->strFilename.c_str(), &source) == 0;
+	if (tOptions->useCache && bHaveSource && mapBinaryMatrix(strCache, &source, tInput))
+	{
+		return true;
+	}
+
+	int iNumCols;
+	if (! parseMatrixFile(tOptions->strFilename, tInput, iNumCols))
+	{
+		return false;
+	}
+
+	if (tOptions->useCache && bHaveSource)
+	{
+		writeBinaryMatrix(strCache, &source, iNumCols, tInput);
+	}
 
 	return true;
 }
@@ -228,94 +689,50 @@ bool loadInputFile_4SMXV(ooo_options *tOptions, ooo_input *tInput)
 // create random x vector
 void randomRHS(ooo_input *tInput) 
 {
-	srand(42);
-	tInput->x = new double[tInput->stNumRows];
-	for(int i = 0; i < tInput->stNumRows; ++i) 
+	tInput->x = tInput->tMemory.allocate<double>(tInput->stNumRows);
+	generateVector(tInput->stNumRows, tInput->x);
+}
+
+// load x vector, one value per row
+bool loadVector(ooo_options *tOptions, ooo_input *tInput)
+{
+	tInput->x = tInput->tMemory.allocate<double>(tInput->stNumRows);
+	if (! parseVectorFile(tOptions->strXFilename, tInput->stNumRows, tInput->x))
 	{
-		tInput->x[i] = (double)rand() / (double)RAND_MAX;
+		tInput->tMemory.release(tInput->x);
+		tInput->x = NULL;
+		return false;
 	}
+	return true;
 }
 
-// create random square Matrix of given size, diagonal structured with the probability q
-void createMatrix(ooo_options *tOptions, ooo_input* tInput) 
+// create a synthetic square matrix of the structure selected with --structure
+bool createMatrix(ooo_options *tOptions, ooo_input* tInput) 
 {
-	srand(42);
-
-	tInput->stNumRows = tOptions->nRows;
-	tInput->stNumNonzeros = tOptions->nzPerRow * tOptions->nRows;
-	tInput->val = new double[tInput->stNumNonzeros];
-	tInput->col = new int[tInput->stNumNonzeros];
-	tInput->row = new int[tInput->stNumRows+1];
-	
-	// temporary column vector per row
-	std::vector<int> cols;
-	cols.resize(tOptions->nzPerRow);
-
-	int nz = 0;
-	for(int i = 0; i < tOptions->nRows; i++) 
+	if (! generateMatrix(tOptions, tInput))
 	{
-		tInput->row[i] = nz;
-
-		for(int j = 0; j < tOptions->nzPerRow; j++)
-		{
-			int c = i + j - tOptions->nzPerRow/2;
-			if(c < 0)
-			{
-				cols[j] = -1;
-			}
-			else if(c >= tInput->stNumRows)
-			{
-				cols[j] = tInput->stNumRows;
-			}
-			else
-			{
-				cols[j] = c;
-			}
-
-			// move value to random column with probability q
-			if((double)rand() / (double)RAND_MAX < tOptions->q) {
-				int newCol = rand() % tInput->stNumRows;
-				// prevent the same column twice
-				while(std::find(cols.begin(), cols.end(), newCol) != cols.end())
-				{
-					newCol = rand() % tInput->stNumRows;
-				}
-				cols[j] = newCol;
-			}
-		}
-
-		// sort cols
-		std::sort(cols.begin(), cols.end());
-
-		for(int j = 0; j < tOptions->nzPerRow; j++) 
-		{
-			// random double value between 0 and 1
-			tInput->val[nz] = (double)rand() / (double)RAND_MAX;
-
-			// continue if column was out of bounds
-			if(cols[j] == -1 || cols[j] == tInput->stNumRows) continue;
-
-			tInput->col[nz] = cols[j];
-			nz++;
-		}
+		return false;
 	}
-	
-	tInput->stNumNonzeros = nz;
-	tInput->row[tInput->stNumRows] = tInput->stNumNonzeros;
 
 	if(tOptions->writeMat) writeMatrix(tInput);
+	return true;
 }
 
 // write matrix to file
 void writeMatrix(ooo_input* tInput) {
 	FILE* fp = fopen("input-matrix/testMat.txt", "w");
-	fprintf(fp, "%% %dx%d %d nonzeros\n", tInput->stNumRows, tInput->stNumRows, tInput->stNumNonzeros);
+	if (fp == NULL)
+	{
+		std::cerr << "ERROR: could not write input-matrix/testMat.txt" << std::endl;
+		return;
+	}
+	fprintf(fp, "%% %dx%d %lld nonzeros\n", tInput->stNumRows, tInput->stNumRows, (long long) tInput->stNumNonzeros);
 
 	for (int i = 0; i < tInput->stNumRows; i++)
 	{
-		int rowbeg = tInput->row[i];
-		int rowend = tInput->row[i+1];
-		int nz;
+		int64_t rowbeg = tInput->row[i];
+		int64_t rowend = tInput->row[i+1];
+		int64_t nz;
 		for (nz = rowbeg; nz < rowend; nz++)
 		{
 			fprintf(fp, "%d %d %lf\n", i+1, tInput->col[nz] + 1, tInput->val[nz]);
@@ -323,39 +740,3 @@ void writeMatrix(ooo_input* tInput) {
 	}
 	fclose(fp);
 }
-
-// checks if the MXV is done correctly by computing the sum of all elements in the result vector
-void print_error_check(double *result, ooo_input *tInput)
-{
-	printf("\nCorrectness check\n");
-	
-	// determine correct result for input matrix
-	double errorMargin = 0.000001;
-
-	double total = 0.0;
-	for (int i = 0; i < tInput->stNumRows; i++)
-	{
-		total += result[i];
-	}
-
-	switch (tInput->stNumRows) {
-	case SIZE_SMALL:
-		if(fabs(total - RES_SMALL) > errorMargin) {
-			printf("Incorrect result! Error in computation.\n");
-			return;
-		}
-		break;
-	case SIZE_LARGE:
-		if(fabs(total - RES_LARGE) > errorMargin) {
-			printf("Incorrect result! Error in computation.\n");
-			return;
-		}
-		break;
-	default:
-		printf("unknown matrix, skipping correctness check\n");
-		return;
-	}
-
-	printf("Success, correct result.\n");
-}
-
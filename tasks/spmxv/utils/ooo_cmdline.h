@@ -5,23 +5,74 @@
 // C++ header
 #include <string>
 #include <limits>
-#include <ios>
+
+// C header
+#include <stdint.h>
 
 // utility header
 #include "anyoption.h"
+#include "ooo_memory.h"
 
 #define MFORMAT_CSR 0
 #define MFORMAT_ELLPACK 1
+#define MFORMAT_SELL 2
+#define MFORMAT_CSR_RL 3
+#define MFORMAT_CSR_MERGE 4
+#define MFORMAT_CSR_CMP 5
+#define MFORMAT_CSR_SYM 6
+#define MFORMAT_CSR_PANEL 7
+#define MFORMAT_AUTO 8
+#define MFORMAT_BCSR 9
+
+#define VALUE_DOUBLE 0
+#define VALUE_AUTO 1
+#define VALUE_FLOAT 2
+
+#define REORDER_NONE 0
+#define REORDER_RCM 1
+#define REORDER_PART 2
+#define REORDER_COLOUR 3
+
+#define SOLVER_NONE 0
+#define SOLVER_CG 1
+#define SOLVER_PIPECG 2
+#define SOLVER_BICGSTAB 3
+
+#define PRECOND_NONE 0
+#define PRECOND_JACOBI 1
+#define PRECOND_ILU0 2
+
+#define TRANSPOSE_NONE 0
+#define TRANSPOSE_AUTO 1
+#define TRANSPOSE_BUFFERS 2
+#define TRANSPOSE_CSC 3
+
+#define XVECTOR_ONES 0
+#define XVECTOR_RANDOM 1
+#define XVECTOR_FILE 2
+
+#define STRUCTURE_DIAG 0
+#define STRUCTURE_BAND 1
+#define STRUCTURE_BLOCK 2
+#define STRUCTURE_POWERLAW 3
+#define STRUCTURE_STENCIL2D 4
+#define STRUCTURE_STENCIL3D 5
 
 
+/**
+ * CSR matrix with 64 bit row pointers, so the nonzeros may exceed 2^31,
+ * and 32 bit column indices. tMemory owns the arrays, whether allocated
+ * or mapped from a binary matrix, and releases them with the input.
+ */
 struct ooo_input
 {
-	int				stNumNonzeros;
+	int64_t			stNumNonzeros;
 	int				stNumRows;
 	double			*val;
 	int				*col;
-	int				*row;
+	int64_t			*row;
 	double			*x;
+	ooo_memory		tMemory;
 };
 
 
@@ -31,89 +82,67 @@ struct timespan
 	double dEnd;
 };
 
+/**
+ * Modelled memory traffic of one repetition and the measured STREAM triad
+ * bandwidth (0 if not measured) of the roofline report.
+ */
+struct ooo_roofline
+{
+	double			dMatrixBytes;	// values, indices and format metadata
+	double			dXBytes;
+	double			dYBytes;
+	double			dStreamBandwidth;	// GB/s
+	double			dCacheBytes;		// last level cache, a smaller working set is not memory bound
+};
+
 struct ooo_options
 {
 	int			iNumThreads;					// number of threads to be used
 	int			iNumRepetitions;				// number of repetitions
 	string		strFilename;					// use input file
-    int         mformat;                        // matrix format used: csr or ep(ELLPACK)
+    int         mformat;                        // matrix format used: csr, ep(ELLPACK), sell(SELL-C-sigma), csr-rl(CSR with row-length dispatch), csr-merge(merge-path CSR) csr-cmp(compressed CSR), csr-sym(symmetric CSR), csr-panel(column-panel CSR), auto(autotuned) or bcsr(register-blocked CSR)
+    string      strTuneCache;                   // if auto: file of the cached tuning decisions, empty to always tune
+    int         iNumVectors;                    // number of right-hand sides multiplied at once
+    int         valuePrecision;                 // if compressed CSR: value storage double, auto(float where exact) or float
+    int         panelCols;                      // if column-panel CSR: columns per panel
+    int         bcsrRows;                       // if bcsr: block rows, 0 to detect the block size
+    int         bcsrCols;                       // if bcsr: block columns, 0 to detect the block size
+    int         transpose;                      // if csr: multiply with A^T instead, none, auto, buffers(per-thread y buffers) or csc(transposed copy)
+    double      dTransposeBudget;               // if transpose auto: bytes the transposed copy may take, 0 for half the free memory
+    bool        persistent;                     // if csr: run all repetitions in one parallel region
+    int         solver;                         // iterative solver run instead of the SpMV benchmark: none, cg, pipecg(pipelined CG) or bicgstab
+    double      dTolerance;                     // if solver: relative residual to reach
+    int         iMaxIterations;                 // if solver: iteration limit
+    int         precond;                        // preconditioner: none, jacobi or ilu0
+    int         xVector;                        // input vector x: ones, random or read from strXFilename
+    string      strXFilename;                   // if xVector is file: one value per row
+    bool        replicateX;                     // if csr: one copy of x per NUMA node
+    bool        numaDomains;                    // if csr: rows, matrix, x and y split into node-local slices per NUMA node
+    int         iNumRanks;                      // if csr: processes the rows are split across, halo exchange over shared memory or MPI
+    int         reorder;                        // symmetric reordering applied after loading: none, rcm(reverse Cuthill-McKee), part(recursive bisection) or colour(multicolouring)
+    int         sellC;                          // if SELL-C-sigma: chunk size C
+    int         sellSigma;                      // if SELL-C-sigma: sorting window sigma
     bool        createMat;                      // create matrix or read file
     int         nRows;                          // if creating matrix: number of rows
     float       q;                              // if creating matrix: probability of moving entry
     int         nzPerRow;                       // if creating matrix: number of non zeros per row
     bool        writeMat;                       // if creating matrix: write matrix to file
+    int         structure;                      // if creating matrix: diag, band, block, powerlaw, stencil2d or stencil3d
+    int         bandwidth;                      // if creating a band matrix: max. distance from the diagonal, 0 for 4 * nzPerRow
+    int         blockSize;                      // if creating a block-diagonal matrix: rows per block
+    bool        useCache;                       // read/write the binary matrix cache <filename>.bin
+    bool        verify;                         // compare y element-wise with a compensated reference SpMV
+    double      dVerifyTolerance;               // if verify: relative tolerance, 0 for the rounding error bound of each row
+    bool        stream;                         // measure the STREAM triad bandwidth for the roofline report
 };
 
 
-void print_performance_results(ooo_options *tOptions, double t1, double t2, timespan *timings, ooo_input *tInput);
+void print_performance_results(ooo_options *tOptions, double t1, double t2, timespan *timings, ooo_input *tInput, timespan *precondTimings, ooo_roofline *tRoofline);
 bool parseCmdLine(ooo_options *options, int argc, char* argv[]);
 bool loadInputFile_4SMXV(ooo_options *tOptions, ooo_input *tInput);
-void print_error_check(double *result, ooo_input *tInput);
 void randomRHS(ooo_input *tInput);
-void createMatrix(ooo_options *tOptions, ooo_input* tInput);
+bool loadVector(ooo_options *tOptions, ooo_input *tInput);
+bool createMatrix(ooo_options *tOptions, ooo_input* tInput);
 void writeMatrix(ooo_input* tInput);
 
-
-/**
- * Loads sparse crs matrix in DROPS human readable format
- * @param strFilename Filename of matrix
- */
-template<typename T, typename indexT>
-void load_drops_matlab_matrix( std::string strFilename_LHS, indexT* & row, indexT* & col, T* & val, indexT & stNumRows, indexT & stNumCols, indexT & stNumNonzeros)
-{
-	indexT stDimension = 0;
-
-    std::ifstream fdat( strFilename_LHS.c_str() );
-    if (!fdat)
-    {
-    	std::cout << "\n";
-        std::cout << "ERROR : could not open input file!\n";
-        std::cout << "\n\n";
-        throw new ios_base::failure("File Input Error!");
-	}
-
-    std::cout << "reading matrix in matlab format from " << strFilename_LHS << std::endl;
-
-    // Read the leading comment: % rows 'x' columns nonzeros "nonzeros\n"
-    while ( fdat && fdat.get() != '%');
-    fdat >> stNumRows;
-    while ( fdat && fdat.get() != 'x');
-    fdat >> stNumCols >> stNumNonzeros;
-    while ( fdat && fdat.get() != '\n');
-    if (!fdat)
-    {
-        std::cout << "SparseMatBaseCL operator>>: Missing \"% rows cols nz\" comment.\n" << std::endl;
-		throw new ios_base::failure("File Input Error!");
-    }
-
-    val = new T[stNumNonzeros];
-    col = new indexT[stNumNonzeros];
-    row = new indexT[stNumRows+1];
-    row[stNumRows] = stNumNonzeros;
-
-    row[0] = 0;
-
-    size_t nz, cr;
-    cr = 0;
-    for ( nz= 0; nz < stNumNonzeros; ++nz )
-    {
-        indexT r, c;
-        T v;
-        fdat >> r >> c >> v;
-        if ( !fdat )
-		{
-            std::cout << "SparseMatBaseCL operator>>: Stream corrupt.\n" << std::endl;
-			throw new ios_base::failure("File Input Error!");
-		}
-
-        if ( r-1 != cr )
-        	row[ ++cr ] = nz;
-        col[ nz ] = c-1;
-        val[ nz ] = v; // save nonzero
-    }
-
-    stDimension = stNumCols;
-    fdat.close();
-}
-
 #endif
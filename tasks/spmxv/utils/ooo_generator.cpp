@@ -0,0 +1,341 @@
+#include "ooo_generator.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <omp.h>
+
+#include <algorithm>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+// independent random streams of the generator
+#define GEN_STREAM_COLS 1
+#define GEN_STREAM_VALS 2
+#define GEN_STREAM_SHIFT 3
+#define GEN_STREAM_LENGTH 4
+#define GEN_STREAM_VECTOR 5
+
+// shape of the Pareto row length distribution, mean = shape / (shape - 1) * minimum
+#define GEN_PARETO_SHAPE 1.5
+
+static const char *structureNames[] = { "diag", "band", "block", "powerlaw", "stencil2d", "stencil3d" };
+
+struct generator_params
+{
+	int				iStructure;
+	int				iNumRows;
+	int				iNzPerRow;
+	double			dShiftProb;
+	int				iBandwidth;
+	int				iBlockSize;
+	int				iGridSide;		// stencils: points per grid dimension
+	bool			bFullStencil;	// stencils: 9/27 instead of 5/7 points
+};
+
+/**
+ * Counter-based random number: the splitmix64 finaliser of a key built
+ * from stream, row and counter.
+ */
+static inline uint64_t counterRandom(uint64_t stream, uint64_t row, uint64_t k)
+{
+	uint64_t z = (row * 0x9E3779B97F4A7C15ULL + k) ^ (stream * 0xD1B54A32D192ED03ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+// uniform in [0, 1)
+static inline double counterUniform(uint64_t stream, uint64_t row, uint64_t k)
+{
+	return (double) (counterRandom(stream, row, k) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// uniform in [0, range)
+static inline int counterBounded(uint64_t stream, uint64_t row, uint64_t k, int range)
+{
+	return (int) (((unsigned __int128) counterRandom(stream, row, k) * (uint64_t) range) >> 64);
+}
+
+/**
+ * Draws count distinct columns of lo .. lo+width-1 in ascending order.
+ * Dense rows draw the excluded columns instead, so the rejection rounds
+ * stay short.
+ */
+static void sampleColumns(int row, int lo, int width, int count, std::vector<int> &cols, std::vector<int> &picked)
+{
+	bool bComplement = 2 * (long) count > width;
+	int draws = bComplement ? width - count : count;
+
+	picked.clear();
+	uint64_t k = 0;
+	while ((int) picked.size() < draws)
+	{
+		int missing = draws - (int) picked.size();
+		for (int j = 0; j < missing; j++)
+		{
+			picked.push_back(counterBounded(GEN_STREAM_COLS, row, k++, width));
+		}
+		std::sort(picked.begin(), picked.end());
+		picked.erase(std::unique(picked.begin(), picked.end()), picked.end());
+	}
+
+	cols.clear();
+	if (! bComplement)
+	{
+		for (int c : picked)
+		{
+			cols.push_back(lo + c);
+		}
+		return;
+	}
+	size_t p = 0;
+	for (int c = 0; c < width; c++)
+	{
+		if (p < picked.size() && picked[p] == c)
+		{
+			p++;
+			continue;
+		}
+		cols.push_back(lo + c);
+	}
+}
+
+// the columns of row i, ascending and distinct
+static void generateRow(const generator_params &P, int i, std::vector<int> &cols, std::vector<int> &scratch)
+{
+	int n = P.iNumRows;
+	int z = P.iNzPerRow;
+	switch (P.iStructure)
+	{
+	case STRUCTURE_BAND:
+	{
+		int lo = std::max(0, i - P.iBandwidth);
+		int hi = std::min(n - 1, i + P.iBandwidth);
+		sampleColumns(i, lo, hi - lo + 1, std::min(z, hi - lo + 1), cols, scratch);
+		break;
+	}
+	case STRUCTURE_BLOCK:
+	{
+		int lo = i / P.iBlockSize * P.iBlockSize;
+		int width = std::min(P.iBlockSize, n - lo);
+		sampleColumns(i, lo, width, std::min(z, width), cols, scratch);
+		break;
+	}
+	case STRUCTURE_POWERLAW:
+	{
+		double dMin = z * (GEN_PARETO_SHAPE - 1.0) / GEN_PARETO_SHAPE;
+		double u = 1.0 - counterUniform(GEN_STREAM_LENGTH, i, 0);
+		double len = dMin * pow(u, -1.0 / GEN_PARETO_SHAPE);
+		int count = (int) std::min<double>(n, std::max(1.0, floor(len + 0.5)));
+		sampleColumns(i, 0, n, count, cols, scratch);
+		break;
+	}
+	case STRUCTURE_STENCIL2D:
+	case STRUCTURE_STENCIL3D:
+	{
+		int side = P.iGridSide;
+		int dims = (P.iStructure == STRUCTURE_STENCIL2D) ? 2 : 3;
+		int px = i % side;
+		int py = (i / side) % side;
+		int pz = i / side / side;
+		cols.clear();
+		// (dz, dy, dx) in lexicographic order gives ascending columns
+		for (int dz = (dims == 3) ? -1 : 0; dz <= ((dims == 3) ? 1 : 0); dz++)
+		{
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					if (! P.bFullStencil && abs(dx) + abs(dy) + abs(dz) > 1)
+					{
+						continue;
+					}
+					if (px + dx < 0 || px + dx >= side || py + dy < 0 || py + dy >= side ||
+						pz + dz < 0 || pz + dz >= side)
+					{
+						continue;
+					}
+					cols.push_back(i + (dz * side + dy) * side + dx);
+				}
+			}
+		}
+		break;
+	}
+	default:
+	{
+		// entries around the diagonal, each moved to an unused random column with probability q
+		cols.resize(z);
+		for (int j = 0; j < z; j++)
+		{
+			cols[j] = i + j - z / 2;
+		}
+		for (int j = 0; j < z; j++)
+		{
+			if (counterUniform(GEN_STREAM_SHIFT, i, j) < P.dShiftProb)
+			{
+				uint64_t k = (uint64_t) j << 32;
+				int c;
+				do
+				{
+					c = counterBounded(GEN_STREAM_COLS, i, k++, n);
+				} while (std::find(cols.begin(), cols.end(), c) != cols.end());
+				cols[j] = c;
+			}
+		}
+		std::sort(cols.begin(), cols.end());
+		cols.erase(std::unique(cols.begin(), cols.end()), cols.end());
+		cols.erase(std::remove_if(cols.begin(), cols.end(), [n](int c) { return c < 0 || c >= n; }), cols.end());
+		break;
+	}
+	}
+}
+
+static inline double generateValue(const generator_params &P, int i, int c, int k)
+{
+	if (P.iStructure == STRUCTURE_STENCIL2D || P.iStructure == STRUCTURE_STENCIL3D)
+	{
+		// diagonal = number of neighbours of an interior point
+		int neighbours;
+		if (P.iStructure == STRUCTURE_STENCIL2D)
+		{
+			neighbours = P.bFullStencil ? 8 : 4;
+		}
+		else
+		{
+			neighbours = P.bFullStencil ? 26 : 6;
+		}
+		return (c == i) ? (double) neighbours : -1.0;
+	}
+	return counterUniform(GEN_STREAM_VALS, i, k);
+}
+
+bool generateMatrix(ooo_options *tOptions, ooo_input *tInput)
+{
+	double t1 = omp_get_wtime();
+
+	generator_params P;
+	P.iStructure = tOptions->structure;
+	P.iNumRows = tOptions->nRows;
+	P.iNzPerRow = tOptions->nzPerRow;
+	P.dShiftProb = tOptions->q;
+	P.iBandwidth = (tOptions->bandwidth > 0) ? tOptions->bandwidth : 4 * tOptions->nzPerRow;
+	P.iBlockSize = tOptions->blockSize;
+	P.iGridSide = 0;
+	P.bFullStencil = false;
+	if (P.iStructure == STRUCTURE_STENCIL2D)
+	{
+		P.iGridSide = std::max(1, (int) floor(sqrt((double) P.iNumRows) + 0.5));
+		P.iNumRows = P.iGridSide * P.iGridSide;
+		P.bFullStencil = P.iNzPerRow >= 9;
+	}
+	else if (P.iStructure == STRUCTURE_STENCIL3D)
+	{
+		P.iGridSide = std::max(1, (int) floor(cbrt((double) P.iNumRows) + 0.5));
+		P.iNumRows = P.iGridSide * P.iGridSide * P.iGridSide;
+		P.bFullStencil = P.iNzPerRow >= 27;
+	}
+
+	int n = P.iNumRows;
+	int64_t *row = tInput->tMemory.allocate<int64_t>(n + 1);
+	int *col = NULL;
+	double *val = NULL;
+	std::vector<int64_t> threadNnz(omp_get_max_threads() + 1, 0);
+	int64_t totalNnz = 0;
+	bool bAllocated = false;
+
+	#pragma omp parallel
+	{
+		int tid = omp_get_thread_num();
+		int nt = omp_get_num_threads();
+		int beg = (int) ((long) n * tid / nt);
+		int end = (int) ((long) n * (tid + 1) / nt);
+		std::vector<int> cols;
+		std::vector<int> scratch;
+
+		// row lengths of the own block
+		int64_t count = 0;
+		for (int i = beg; i < end; i++)
+		{
+			generateRow(P, i, cols, scratch);
+			row[i+1] = cols.size();
+			count += cols.size();
+		}
+		threadNnz[tid+1] = count;
+
+		#pragma omp barrier
+		#pragma omp single
+		{
+			for (int t = 0; t < nt; t++)
+			{
+				threadNnz[t+1] += threadNnz[t];
+			}
+			totalNnz = threadNnz[nt];
+			row[0] = 0;
+			try
+			{
+				col = tInput->tMemory.allocate<int>(totalNnz);
+				val = tInput->tMemory.allocate<double>(totalNnz);
+				bAllocated = true;
+			}
+			catch (const std::bad_alloc &)
+			{
+				bAllocated = false;
+			}
+		}
+
+		if (bAllocated)
+		{
+			// offsets, then columns and values of the own block
+			int64_t offset = threadNnz[tid];
+			for (int i = beg; i < end; i++)
+			{
+				int64_t len = row[i+1];
+				row[i+1] = offset + len;
+				offset += len;
+			}
+			for (int i = beg; i < end; i++)
+			{
+				generateRow(P, i, cols, scratch);
+				int64_t rowBeg = (i == beg) ? threadNnz[tid] : row[i];
+				for (int k = 0; k < (int) cols.size(); k++)
+				{
+					col[rowBeg + k] = cols[k];
+					val[rowBeg + k] = generateValue(P, i, cols[k], k);
+				}
+			}
+		}
+	}
+
+	if (! bAllocated)
+	{
+		std::cerr << "ERROR: not enough memory for the " << totalNnz << " nonzeros of the generated matrix" << std::endl;
+		tInput->tMemory.release();
+		return false;
+	}
+
+	tInput->stNumRows = n;
+	tInput->stNumNonzeros = totalNnz;
+	tInput->row = row;
+	tInput->col = col;
+	tInput->val = val;
+	tOptions->nRows = n;
+	tOptions->strFilename = std::string("(generated ") + structureNames[P.iStructure] + ")";
+
+	std::cout << "Generated " << structureNames[P.iStructure] << " matrix: " << n << " rows, "
+		<< tInput->stNumNonzeros << " nonzeros (" << (double) tInput->stNumNonzeros / std::max(n, 1)
+		<< " per row), took " << omp_get_wtime() - t1 << " s" << std::endl;
+	return true;
+}
+
+void generateVector(int iNumRows, double *x)
+{
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < iNumRows; i++)
+	{
+		x[i] = counterUniform(GEN_STREAM_VECTOR, i, 0);
+	}
+}
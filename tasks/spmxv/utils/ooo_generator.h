@@ -0,0 +1,30 @@
+#ifndef INC_OOOGENERATOR_H
+#define INC_OOOGENERATOR_H
+
+#include "ooo_cmdline.h"
+
+/**
+ * Builds a synthetic square matrix in CSR directly, in two parallel passes
+ * over contiguous row blocks (row lengths, then columns and values). Every
+ * random number is a hash of (stream, row, counter), so the matrix is the
+ * same for any number of threads. Structures:
+ *  diag      nzPerRow entries around the diagonal, each moved to a random
+ *            column with probability q (the original -c generator)
+ *  band      nzPerRow random columns within |i - j| <= bandwidth
+ *  block     nzPerRow random columns within the diagonal block of row i
+ *  powerlaw  Pareto distributed row lengths with mean ~nzPerRow, uniformly
+ *            random columns
+ *  stencil2d 5-point (9-point if nzPerRow >= 9) Laplacian on a square grid
+ *  stencil3d 7-point (27-point if nzPerRow >= 27) Laplacian on a cube
+ * The stencils round nRows to the grid size and are symmetric positive
+ * definite.
+ * @return false if the arrays of the matrix cannot be allocated
+ */
+bool generateMatrix(ooo_options *tOptions, ooo_input *tInput);
+
+/**
+ * Uniform random values in [0, 1) from the same counter-based generator.
+ */
+void generateVector(int iNumRows, double *x);
+
+#endif
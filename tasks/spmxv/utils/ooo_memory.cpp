@@ -0,0 +1,62 @@
+#include "ooo_memory.h"
+
+#include <numa.h>
+#include <sys/mman.h>
+
+#include <iostream>
+#include <new>
+
+static void freeNuma(void *data, size_t bytes)
+{
+	numa_free(data, bytes);
+}
+
+static void freeMapping(void *data, size_t bytes)
+{
+	munmap(data, bytes);
+}
+
+void *ooo_memory::allocateNumaBytes(size_t bytes, bool bInterleaved)
+{
+	void *data = bInterleaved ? numa_alloc_interleaved(bytes) : numa_alloc(bytes);
+	if (data == NULL)
+	{
+		std::cerr << "ERROR: could not allocate " << bytes / 1e6 << " MB" << std::endl;
+		throw std::bad_alloc();
+	}
+	adopt(data, bytes, freeNuma);
+	return data;
+}
+
+void ooo_memory::adoptMapping(void *data, size_t bytes)
+{
+	adopt(data, bytes, freeMapping);
+}
+
+void ooo_memory::adopt(void *data, size_t bytes, void (*destroy)(void*, size_t))
+{
+	ooo_block block = { data, bytes, destroy };
+	blocks.push_back(block);
+}
+
+void ooo_memory::release(void *data)
+{
+	for (size_t k = blocks.size(); k-- > 0; )
+	{
+		if (blocks[k].data == data)
+		{
+			blocks[k].destroy(blocks[k].data, blocks[k].bytes);
+			blocks.erase(blocks.begin() + k);
+			return;
+		}
+	}
+}
+
+void ooo_memory::release()
+{
+	while (! blocks.empty())
+	{
+		blocks.back().destroy(blocks.back().data, blocks.back().bytes);
+		blocks.pop_back();
+	}
+}
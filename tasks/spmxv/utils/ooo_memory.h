@@ -0,0 +1,70 @@
+#ifndef INC_OOOMEMORY_H
+#define INC_OOOMEMORY_H
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * Owner of the arrays of an input matrix or of the kernel, released in
+ * reverse order of allocation when it goes out of scope: heap arrays with
+ * delete[], libnuma allocations with numa_free and a mapped binary matrix
+ * with munmap. It cannot be copied, so every array has exactly one owner.
+ */
+class ooo_memory
+{
+public:
+	ooo_memory() {}
+	~ooo_memory() { release(); }
+
+	// new T[n], at least one element
+	template<typename T> T *allocate(size_t n)
+	{
+		T *data = new T[std::max<size_t>(n, 1)];
+		adopt(data, 0, deleteArray<T>);
+		return data;
+	}
+
+	// numa_alloc of n elements, placed by first touch
+	template<typename T> T *allocateNuma(size_t n)
+	{
+		return (T*) allocateNumaBytes(sizeof(T) * std::max<size_t>(n, 1), false);
+	}
+
+	// numa_alloc_interleaved of n elements, pages spread over all nodes
+	template<typename T> T *allocateInterleaved(size_t n)
+	{
+		return (T*) allocateNumaBytes(sizeof(T) * std::max<size_t>(n, 1), true);
+	}
+
+	// takes over a mapping of bytes bytes at data
+	void adoptMapping(void *data, size_t bytes);
+
+	// releases one array before the owner goes out of scope
+	void release(void *data);
+	void release();
+
+private:
+	struct ooo_block
+	{
+		void			*data;
+		size_t			bytes;
+		void			(*destroy)(void *data, size_t bytes);
+	};
+
+	template<typename T> static void deleteArray(void *data, size_t)
+	{
+		delete[] (T*) data;
+	}
+
+	void *allocateNumaBytes(size_t bytes, bool bInterleaved);
+	void adopt(void *data, size_t bytes, void (*destroy)(void*, size_t));
+
+	std::vector<ooo_block> blocks;
+
+	ooo_memory(const ooo_memory&);
+	ooo_memory &operator=(const ooo_memory&);
+};
+
+#endif
@@ -0,0 +1,594 @@
+#include "ooo_parser.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <omp.h>
+
+#include <algorithm>
+#include <iostream>
+#include <new>
+#include <utility>
+#include <vector>
+
+#define SYMMETRY_GENERAL 0
+#define SYMMETRY_SYMMETRIC 1
+#define SYMMETRY_SKEW 2
+
+/**
+ * Entries scanned by one thread, in file order.
+ */
+struct parser_chunk
+{
+	std::vector<int>	row;
+	std::vector<int>	col;
+	std::vector<double>	val;
+	long				lEntries;		// entry lines, before mirroring
+	bool				bSorted;		// rows non-decreasing within the chunk
+	const char			*pError;		// position of the first malformed line
+	bool				bOutOfMemory;	// the entries did not fit, scanning stopped
+};
+
+static const double powersOf10[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static inline const char *skipBlanks(const char *p, const char *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+	{
+		p++;
+	}
+	return p;
+}
+
+static inline const char *skipLine(const char *p, const char *end)
+{
+	const char *nl = (const char*) memchr(p, '\n', end - p);
+	return (nl != NULL) ? nl + 1 : end;
+}
+
+/**
+ * Scans a non-negative integer, returns NULL if there is none.
+ */
+static inline const char *scanInt(const char *p, const char *end, long &value)
+{
+	p = skipBlanks(p, end);
+	if (p == end || ! isDigit(*p))
+	{
+		return NULL;
+	}
+	value = 0;
+	while (p < end && isDigit(*p))
+	{
+		value = value * 10 + (*p - '0');
+		p++;
+	}
+	return p;
+}
+
+/**
+ * Scans a floating point number. Values with at most 19 significant digits
+ * and a small decimal exponent are converted exactly in registers (Clinger's
+ * fast path), everything else falls back to strtod on a copy of the token.
+ */
+static inline const char *scanDouble(const char *p, const char *end, double &value)
+{
+	p = skipBlanks(p, end);
+	const char *beg = p;
+
+	bool bNegative = false;
+	if (p < end && (*p == '+' || *p == '-'))
+	{
+		bNegative = (*p == '-');
+		p++;
+	}
+
+	uint64_t mantissa = 0;
+	int numDigits = 0;
+	int exp10 = 0;
+	bool bAny = false;
+	bool bExact = true;
+	for (; p < end && isDigit(*p); p++)
+	{
+		bAny = true;
+		if (numDigits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			numDigits += (mantissa != 0);
+		}
+		else
+		{
+			exp10++;
+			bExact = false;
+		}
+	}
+	if (p < end && *p == '.')
+	{
+		for (p++; p < end && isDigit(*p); p++)
+		{
+			bAny = true;
+			if (numDigits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				numDigits += (mantissa != 0);
+				exp10--;
+			}
+			else
+			{
+				bExact = false;
+			}
+		}
+	}
+	if (! bAny)
+	{
+		return NULL;
+	}
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		bool bNegExp = false;
+		if (p < end && (*p == '+' || *p == '-'))
+		{
+			bNegExp = (*p == '-');
+			p++;
+		}
+		long e;
+		p = scanInt(p, end, e);
+		if (p == NULL)
+		{
+			return NULL;
+		}
+		exp10 += bNegExp ? -(int) std::min(e, 100000L) : (int) std::min(e, 100000L);
+	}
+
+	if (bExact && mantissa < (1ULL << 53) && exp10 >= -22 && exp10 <= 22)
+	{
+		value = (double) mantissa;
+		value = (exp10 < 0) ? value / powersOf10[-exp10] : value * powersOf10[exp10];
+		value = bNegative ? -value : value;
+		return p;
+	}
+
+	char buffer[128];
+	size_t len = p - beg;
+	if (len >= sizeof(buffer))
+	{
+		return NULL;
+	}
+	memcpy(buffer, beg, len);
+	buffer[len] = '\0';
+	value = strtod(buffer, NULL);
+	return p;
+}
+
+/**
+ * Scans all entry lines in [p, end), skipping empty and comment lines.
+ */
+static void scanChunk(const char *p, const char *end, bool bPattern, int iSymmetry, parser_chunk &chunk)
+{
+	chunk.lEntries = 0;
+	chunk.bSorted = true;
+	chunk.pError = NULL;
+	size_t estimate = (end - p) / 20;
+	chunk.row.reserve(estimate);
+	chunk.col.reserve(estimate);
+	chunk.val.reserve(estimate);
+
+	while (p < end)
+	{
+		const char *line = p;
+		p = skipBlanks(p, end);
+		if (p == end || *p == '\n' || *p == '%')
+		{
+			p = skipLine(p, end);
+			continue;
+		}
+
+		long r, c;
+		double v = 1.0;
+		p = scanInt(p, end, r);
+		if (p != NULL)
+		{
+			p = scanInt(p, end, c);
+		}
+		if (p != NULL && ! bPattern)
+		{
+			p = scanDouble(p, end, v);
+		}
+		if (p == NULL || r < 1 || c < 1 || r > std::numeric_limits<int>::max() || c > std::numeric_limits<int>::max())
+		{
+			chunk.pError = line;
+			return;
+		}
+		p = skipLine(p, end);
+		chunk.lEntries++;
+
+		if (! chunk.row.empty() && r - 1 < chunk.row.back())
+		{
+			chunk.bSorted = false;
+		}
+		chunk.row.push_back(r - 1);
+		chunk.col.push_back(c - 1);
+		chunk.val.push_back(v);
+
+		// mirror the strict other triangle
+		if (iSymmetry != SYMMETRY_GENERAL && r != c)
+		{
+			chunk.bSorted = false;
+			chunk.row.push_back(c - 1);
+			chunk.col.push_back(r - 1);
+			chunk.val.push_back(iSymmetry == SYMMETRY_SKEW ? -v : v);
+		}
+	}
+}
+
+/**
+ * Reads the Matrix Market banner and size line or the DROPS size comment,
+ * returns the start of the entries or NULL.
+ */
+static const char *parseHeader(const char *p, const char *end, long &numRows, long &numCols, long &numEntries, bool &bPattern, int &iSymmetry)
+{
+	bPattern = false;
+	iSymmetry = SYMMETRY_GENERAL;
+
+	if (end - p >= 14 && strncmp(p, "%%MatrixMarket", 14) == 0)
+	{
+		std::string banner(p, skipLine(p, end));
+		std::transform(banner.begin(), banner.end(), banner.begin(), ::tolower);
+		if (banner.find("coordinate") == std::string::npos ||
+			banner.find("complex") != std::string::npos ||
+			banner.find("hermitian") != std::string::npos)
+		{
+			std::cerr << "ERROR: only real/integer/pattern coordinate Matrix Market files are supported" << std::endl;
+			return NULL;
+		}
+		bPattern = banner.find("pattern") != std::string::npos;
+		if (banner.find("skew-symmetric") != std::string::npos)
+		{
+			iSymmetry = SYMMETRY_SKEW;
+		}
+		else if (banner.find("symmetric") != std::string::npos)
+		{
+			iSymmetry = SYMMETRY_SYMMETRIC;
+		}
+
+		// comments, then "rows cols entries"
+		p = skipLine(p, end);
+		while (p < end && (*skipBlanks(p, end) == '%' || *skipBlanks(p, end) == '\n'))
+		{
+			p = skipLine(p, end);
+		}
+		if ((p = scanInt(p, end, numRows)) == NULL ||
+			(p = scanInt(p, end, numCols)) == NULL ||
+			(p = scanInt(p, end, numEntries)) == NULL)
+		{
+			std::cerr << "ERROR: missing Matrix Market size line" << std::endl;
+			return NULL;
+		}
+		return skipLine(p, end);
+	}
+
+	// DROPS: "% rows x cols nonzeros nonzeros"
+	p = skipBlanks(p, end);
+	if (p == end || *p != '%' ||
+		(p = scanInt(p + 1, end, numRows)) == NULL ||
+		(p = skipBlanks(p, end)) == end || *p != 'x' ||
+		(p = scanInt(p + 1, end, numCols)) == NULL ||
+		(p = scanInt(p, end, numEntries)) == NULL)
+	{
+		std::cerr << "ERROR: missing \"% rows x cols nz\" comment" << std::endl;
+		return NULL;
+	}
+	return skipLine(p, end);
+}
+
+bool parseMatrixFile(const std::string &strFilename, ooo_input *tInput, int &iNumCols)
+{
+	int fd = open(strFilename.c_str(), O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		std::cerr << "ERROR: could not read input file " << strFilename << std::endl;
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		return false;
+	}
+
+	const char *data = (const char*) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		std::cerr << "ERROR: could not map input file " << strFilename << std::endl;
+		return false;
+	}
+	madvise((void*) data, st.st_size, MADV_SEQUENTIAL);
+	const char *end = data + st.st_size;
+
+	std::cout << "reading matrix in parallel from " << strFilename << std::endl;
+
+	long numRows, numCols, numEntries;
+	bool bPattern;
+	int iSymmetry;
+	const char *body = parseHeader(data, end, numRows, numCols, numEntries, bPattern, iSymmetry);
+	if (body == NULL || numRows > std::numeric_limits<int>::max() || numCols > std::numeric_limits<int>::max())
+	{
+		munmap((void*) data, st.st_size);
+		return false;
+	}
+
+	// scan chunks split at line boundaries
+	int numChunks = omp_get_max_threads();
+	std::vector<parser_chunk> chunks(numChunks);
+	#pragma omp parallel for schedule(static, 1)
+	for (int t = 0; t < numChunks; t++)
+	{
+		const char *beg = body + (end - body) * t / numChunks;
+		const char *stop = body + (end - body) * (t + 1) / numChunks;
+		if (t > 0)
+		{
+			beg = skipLine(beg - 1, end);
+		}
+		if (t < numChunks - 1)
+		{
+			stop = skipLine(stop - 1, end);
+		}
+		// an exception must not leave the parallel region
+		chunks[t].bOutOfMemory = false;
+		try
+		{
+			scanChunk(beg, std::max(beg, stop), bPattern, iSymmetry, chunks[t]);
+		}
+		catch (const std::bad_alloc &)
+		{
+			chunks[t].bOutOfMemory = true;
+		}
+	}
+
+	// per-thread counts and their prefix sum give every chunk its output offset
+	std::vector<long> offsets(numChunks + 1, 0);
+	long numEntriesRead = 0;
+	bool bSorted = true;
+	int lastRow = -1;
+	for (int t = 0; t < numChunks; t++)
+	{
+		parser_chunk &chunk = chunks[t];
+		if (chunk.bOutOfMemory)
+		{
+			std::cerr << "ERROR: not enough memory to parse " << strFilename << std::endl;
+			munmap((void*) data, st.st_size);
+			return false;
+		}
+		if (chunk.pError != NULL)
+		{
+			long lineNumber = 1 + std::count(data, chunk.pError, '\n');
+			std::cerr << "ERROR: malformed entry in line " << lineNumber << " of " << strFilename << std::endl;
+			munmap((void*) data, st.st_size);
+			return false;
+		}
+		offsets[t+1] = offsets[t] + chunk.row.size();
+		numEntriesRead += chunk.lEntries;
+		if (! chunk.row.empty())
+		{
+			bSorted = bSorted && chunk.bSorted && chunk.row.front() >= lastRow;
+			lastRow = chunk.row.back();
+		}
+	}
+	munmap((void*) data, st.st_size);
+
+	// the header has to describe the data, symmetric files announce the stored triangle
+	long numNonzeros = offsets[numChunks];
+	if (numEntriesRead != numEntries)
+	{
+		std::cerr << "ERROR: header announces " << numEntries << " entries, file contains " << numEntriesRead << std::endl;
+		return false;
+	}
+	if (numRows == 0 && numNonzeros > 0)
+	{
+		std::cerr << "ERROR: header announces an empty matrix, file contains " << numNonzeros << " entries" << std::endl;
+		return false;
+	}
+
+	int n = numRows;
+	int64_t *row = tInput->tMemory.allocate<int64_t>(n + 1);
+	int *col = tInput->tMemory.allocate<int>(numNonzeros);
+	double *val = tInput->tMemory.allocate<double>(numNonzeros);
+	bool bInRange = true;
+
+	if (bSorted)
+	{
+		// row-sorted input (DROPS): copy every chunk to its offset, keeping file order
+		#pragma omp parallel for schedule(static, 1) reduction(&&:bInRange)
+		for (int t = 0; t < numChunks; t++)
+		{
+			parser_chunk &chunk = chunks[t];
+			int prevRow = -1;
+			for (int u = t - 1; u >= 0 && prevRow < 0; u--)
+			{
+				prevRow = chunks[u].row.empty() ? -1 : chunks[u].row.back();
+			}
+			for (size_t k = 0; k < chunk.row.size(); k++)
+			{
+				long nz = offsets[t] + k;
+				int r = chunk.row[k];
+				bInRange = bInRange && r < n && chunk.col[k] < numCols;
+				for (int i = prevRow + 1; i <= std::min(r, n - 1); i++)
+				{
+					row[i] = nz;
+				}
+				prevRow = r;
+				col[nz] = chunk.col[k];
+				val[nz] = chunk.val[k];
+			}
+		}
+		for (int i = std::max(lastRow + 1, 0); i <= n; i++)
+		{
+			row[i] = numNonzeros;
+		}
+	}
+	else
+	{
+		// unsorted input: counting sort by row, then order each row by column
+		std::vector<int64_t> cursor(n + 1, 0);
+		#pragma omp parallel for schedule(static, 1) reduction(&&:bInRange)
+		for (int t = 0; t < numChunks; t++)
+		{
+			for (size_t k = 0; k < chunks[t].row.size(); k++)
+			{
+				int r = chunks[t].row[k];
+				if (r >= n || chunks[t].col[k] >= numCols)
+				{
+					bInRange = false;
+					continue;
+				}
+				#pragma omp atomic
+				cursor[r + 1]++;
+			}
+		}
+		if (bInRange)
+		{
+			for (int i = 0; i < n; i++)
+			{
+				cursor[i + 1] += cursor[i];
+			}
+			std::copy(cursor.begin(), cursor.end(), row);
+
+			#pragma omp parallel for schedule(static, 1)
+			for (int t = 0; t < numChunks; t++)
+			{
+				for (size_t k = 0; k < chunks[t].row.size(); k++)
+				{
+					int64_t nz;
+					#pragma omp atomic capture
+					nz = cursor[chunks[t].row[k]]++;
+					col[nz] = chunks[t].col[k];
+					val[nz] = chunks[t].val[k];
+				}
+			}
+
+			#pragma omp parallel
+			{
+				std::vector<std::pair<int, double> > entries;
+				#pragma omp for schedule(dynamic, 256)
+				for (int i = 0; i < n; i++)
+				{
+					entries.clear();
+					for (int64_t nz = row[i]; nz < row[i+1]; nz++)
+					{
+						entries.push_back(std::make_pair(col[nz], val[nz]));
+					}
+					std::sort(entries.begin(), entries.end());
+					for (int64_t nz = row[i]; nz < row[i+1]; nz++)
+					{
+						col[nz] = entries[nz - row[i]].first;
+						val[nz] = entries[nz - row[i]].second;
+					}
+				}
+			}
+		}
+	}
+
+	if (! bInRange)
+	{
+		std::cerr << "ERROR: entry outside of the announced " << numRows << "x" << numCols << " matrix" << std::endl;
+		tInput->tMemory.release(val);
+		tInput->tMemory.release(col);
+		tInput->tMemory.release(row);
+		return false;
+	}
+
+	tInput->stNumRows = n;
+	tInput->stNumNonzeros = numNonzeros;
+	tInput->row = row;
+	tInput->col = col;
+	tInput->val = val;
+	iNumCols = numCols;
+	return true;
+}
+
+bool parseVectorFile(const std::string &strFilename, int iNumRows, double *x)
+{
+	int fd = open(strFilename.c_str(), O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		std::cerr << "ERROR: could not read vector file " << strFilename << std::endl;
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		return false;
+	}
+
+	const char *data = (const char*) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		std::cerr << "ERROR: could not map vector file " << strFilename << std::endl;
+		return false;
+	}
+	const char *end = data + st.st_size;
+	const char *p = data;
+	bool bMatrixMarket = end - p >= 14 && strncmp(p, "%%MatrixMarket", 14) == 0;
+
+	// values separated by any white space, comment lines start with %
+	auto skipSpace = [&]() {
+		while (p < end)
+		{
+			p = skipBlanks(p, end);
+			if (p < end && *p == '\n')
+			{
+				p++;
+			}
+			else if (p < end && *p == '%')
+			{
+				p = skipLine(p, end);
+			}
+			else
+			{
+				break;
+			}
+		}
+	};
+
+	bool bValid = true;
+	if (bMatrixMarket)
+	{
+		// dense "rows 1" array
+		long numRows, numCols;
+		skipSpace();
+		bValid = (p = scanInt(p, end, numRows)) != NULL && (p = scanInt(p, end, numCols)) != NULL &&
+			numRows == iNumRows && numCols == 1;
+	}
+	for (int i = 0; bValid && i < iNumRows; i++)
+	{
+		skipSpace();
+		bValid = (p = scanDouble(p, end, x[i])) != NULL;
+	}
+	if (bValid)
+	{
+		skipSpace();
+		bValid = p == end;
+	}
+	munmap((void*) data, st.st_size);
+
+	if (! bValid)
+	{
+		std::cerr << "ERROR: vector file " << strFilename << " does not hold exactly " << iNumRows << " values" << std::endl;
+		return false;
+	}
+	return true;
+}
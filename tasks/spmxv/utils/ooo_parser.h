@@ -0,0 +1,27 @@
+#ifndef INC_OOOPARSER_H
+#define INC_OOOPARSER_H
+
+#include <string>
+
+#include "ooo_cmdline.h"
+
+/**
+ * Parses a sparse matrix in DROPS matlab format ("% rows x cols nz nonzeros"
+ * followed by 1-based "row col value" lines) or Matrix Market coordinate
+ * format into CSR. The file is mapped and split at line boundaries, every
+ * thread scans its own chunk and the CSR arrays are assembled from the
+ * per-thread counts. Symmetric Matrix Market input is expanded to both
+ * triangles. The arrays are owned by tInput->tMemory.
+ * @return false on I/O or format errors or if the entries contradict the
+ * header's size and count, with a message on stderr
+ */
+bool parseMatrixFile(const std::string &strFilename, ooo_input *tInput, int &iNumCols);
+
+/**
+ * Reads iNumRows values separated by white space, optionally as a Matrix
+ * Market "rows 1" array, into x.
+ * @return false if the file does not hold exactly iNumRows values
+ */
+bool parseVectorFile(const std::string &strFilename, int iNumRows, double *x);
+
+#endif
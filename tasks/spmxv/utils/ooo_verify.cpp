@@ -0,0 +1,102 @@
+#include "ooo_verify.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <omp.h>
+
+#include <algorithm>
+#include <vector>
+
+// error-free transformation of a sum, s + e = a + b exactly
+static inline void twoSum(double a, double b, double &s, double &e)
+{
+	s = a + b;
+	double z = s - a;
+	e = (a - (s - z)) + (b - z);
+}
+
+/**
+ * Row i times lane v of x, as accurate as if computed in twice the working
+ * precision, and sum_j |a_ij x_j| in absSum.
+ */
+static inline double referenceRow(ooo_input *tInput, const double *x, int nv, int i, int v, double &absSum)
+{
+	double p = 0.0;
+	double c = 0.0;
+	absSum = 0.0;
+	for (int64_t nz = tInput->row[i]; nz < tInput->row[i+1]; nz++)
+	{
+		double a = tInput->val[nz];
+		double b = x[(size_t) tInput->col[nz] * nv + v];
+		double h = a * b;
+		double r = fma(a, b, -h);
+		double q;
+		twoSum(p, h, p, q);
+		c += q + r;
+		absSum += fabs(h);
+	}
+	return p + c;
+}
+
+bool verifyResult(ooo_options *tOptions, ooo_input *tInput, const double *x, const double *y)
+{
+	int n = tInput->stNumRows;
+	int nv = tOptions->iNumVectors;
+	const double u = DBL_EPSILON / 2;
+	double valueRoundoff = 0.0;
+	if (tOptions->mformat == MFORMAT_CSR_CMP && tOptions->valuePrecision == VALUE_FLOAT)
+	{
+		valueRoundoff = FLT_EPSILON / 2;
+	}
+
+	// per lane, so that mixed up vectors show which lanes are wrong
+	std::vector<double> vecError(nv, 0.0);
+	std::vector<long> vecWrong(nv, 0);
+	std::vector<int> vecFirst(nv, n);
+	double *laneError = vecError.data();
+	long *laneWrong = vecWrong.data();
+	int *laneFirst = vecFirst.data();
+	#pragma omp parallel for schedule(dynamic, 1024) \
+		reduction(max:laneError[:nv]) reduction(+:laneWrong[:nv]) reduction(min:laneFirst[:nv])
+	for (int i = 0; i < n; i++)
+	{
+		int len = (int) (tInput->row[i+1] - tInput->row[i]);
+		double tol = (tOptions->dVerifyTolerance > 0.0) ? tOptions->dVerifyTolerance : valueRoundoff + (len + 2) * u;
+		for (int v = 0; v < nv; v++)
+		{
+			double absSum;
+			double ref = referenceRow(tInput, x, nv, i, v, absSum);
+			double diff = fabs(y[(size_t) i * nv + v] - ref);
+			double err = (absSum > 0.0) ? diff / absSum : (diff == 0.0 ? 0.0 : INFINITY);
+			// also catches NaN
+			if (! (err <= tol))
+			{
+				laneWrong[v]++;
+				laneFirst[v] = std::min(laneFirst[v], i);
+			}
+			laneError[v] = std::max(laneError[v], err);
+		}
+	}
+
+	printf("\nCorrectness check\n");
+	printf("Max. relative error:       %e\n", *std::max_element(laneError, laneError + nv));
+	bool bCorrect = true;
+	for (int v = 0; v < nv; v++)
+	{
+		if (laneWrong[v] > 0)
+		{
+			double absSum;
+			int i = laneFirst[v];
+			printf("Incorrect result! %ld of %d entries of vector %d exceed the tolerance, first in row %d: %.17g instead of %.17g\n",
+				laneWrong[v], n, v, i, y[(size_t) i * nv + v], referenceRow(tInput, x, nv, i, v, absSum));
+			bCorrect = false;
+		}
+	}
+	if (bCorrect)
+	{
+		printf("Success, correct result.\n");
+	}
+	return bCorrect;
+}
@@ -0,0 +1,19 @@
+#ifndef INC_OOOVERIFY_H
+#define INC_OOOVERIFY_H
+
+#include "ooo_cmdline.h"
+
+/**
+ * Checks y = A x element-wise against a reference computed row by row with
+ * a compensated dot product (Ogita, Rump and Oishi's Dot2), in parallel and
+ * outside of any time measurement. x and y are row-major n x nv. The error
+ * of y_i is relative to sum_j |a_ij x_j|, so cancelling rows are judged by
+ * the accuracy any summation order can deliver. With dTolerance 0 the
+ * bound is (row length + 2) unit roundoffs, plus the float rounding of the
+ * values if csr-cmp stores them as float. Every vector reports its own
+ * failures.
+ * @return false if any entry exceeds the tolerance
+ */
+bool verifyResult(ooo_options *tOptions, ooo_input *tInput, const double *x, const double *y);
+
+#endif